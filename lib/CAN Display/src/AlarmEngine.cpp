@@ -0,0 +1,122 @@
+#include "AlarmEngine.h"
+#include <math.h>
+
+void AlarmEngine::begin() {
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        rules[i] = AlarmRule{};
+        scaled[i].decimals = 0xFF;      // Scaled on the first value
+        pastMask[i] = 0;
+    }
+    acked = 0;
+    seqlock.beginWrite();
+    state = AlarmStatus{};
+    seqlock.endWrite();
+}
+
+void AlarmEngine::setRule(int channel, const AlarmRule& rule) {
+    if (channel < 0 || channel >= MAX_CHANNELS) return;
+    rules[channel] = rule;
+    scaled[channel].decimals = 0xFF;
+    pastMask[channel] = 0;
+}
+
+void AlarmEngine::setOutputPin(uint8_t pin, AlarmLevel atLevel) {
+    outputPin = pin;
+    outputLevel = atLevel;
+    outputOn = false;
+    if (pin != ALARM_NO_PIN) halConfigureOutput(pin);
+}
+
+void AlarmEngine::status(AlarmStatus& out) const {
+    seqlock.read([&] { out = state; });
+    out.unacknowledged &= ~acked.load();
+}
+
+void AlarmEngine::rescale(int channel, uint8_t decimals) {
+    const AlarmRule& rule = rules[channel];
+    float scale = SCALING_POW10[decimals < SCALING_MAX_DECIMALS ? decimals : SCALING_MAX_DECIMALS] * (rule.below ? -1.0f : 1.0f);
+    Thresholds& t = scaled[channel];
+    t.decimals = decimals;
+    t.warning = (int32_t)lroundf(rule.warning * scale);
+    t.critical = (int32_t)lroundf(rule.critical * scale);
+    t.hysteresis = (int32_t)lroundf(fabsf(rule.hysteresis * scale));
+}
+
+void AlarmEngine::updateOutput() {
+    if (outputPin == ALARM_NO_PIN) return;
+    bool on = false;
+    for (int i = 0; i < MAX_CHANNELS && !on; i++) {
+        on = state.level[i] >= outputLevel;
+    }
+    if (on != outputOn) {
+        outputOn = on;
+        halWriteOutput(outputPin, on);
+    }
+}
+
+void AlarmEngine::onChannel(int channel, const ChannelValue& value, uint8_t decimals) {
+    const AlarmRule& rule = rules[channel];
+    if (!rule.enabled) return;
+    if (scaled[channel].decimals != decimals) rescale(channel, decimals);
+    const Thresholds& t = scaled[channel];
+
+    // Mirrored for below rules, from here on worse is higher
+    int32_t v = rule.below ? -value.value : value.value;
+    uint32_t nowUs = value.timestampUs;
+    AlarmLevel current = state.level[channel];
+
+    // Runs of frames past each threshold, for the hold time
+    const int32_t threshold[2] = {t.warning, t.critical};
+    AlarmLevel next = ALARM_OK;
+    for (int i = 0; i < 2; i++) {
+        AlarmLevel level = (AlarmLevel)(ALARM_WARNING + i);
+        if (v >= threshold[i]) {
+            if (!(pastMask[channel] & (1 << i))) {
+                pastMask[channel] |= 1 << i;
+                pastSinceUs[channel][i] = nowUs;
+            }
+            if (nowUs - pastSinceUs[channel][i] >= (uint32_t)rule.holdMs * 1000) next = level;
+        }
+        else {
+            pastMask[channel] &= ~(1 << i);
+        }
+        // Already there: stays until it is back by more than the hysteresis
+        if (current >= level && v + t.hysteresis >= threshold[i] && next < level) next = level;
+    }
+
+    // Worse than anything since the latch started: kept for the alarm screen
+    ChannelMask bit = (ChannelMask)1 << channel;
+    bool raise = next > current;
+    bool latched = (state.unacknowledged & bit) && !(acked.load() & bit);
+    int32_t worst = rule.below ? -state.worst[channel] : state.worst[channel];
+    bool worse = latched && v > worst;
+    if (!raise && !worse && next == current) return;
+
+    seqlock.beginWrite();
+    state.level[channel] = next;
+    if (next == ALARM_OK) {
+        state.active &= ~bit;
+    }
+    else {
+        state.active |= bit;
+    }
+    if (raise) {
+        if (!latched) {                 // New latch, forget the acknowledged one
+            state.latched[channel] = ALARM_OK;
+            state.worst[channel] = value.value;
+        }
+        if (next > state.latched[channel]) state.latched[channel] = next;
+        acked.fetch_and((ChannelMask)~bit);
+        state.unacknowledged |= bit;
+        state.raises++;
+        state.raisedUs = halMicros();
+        state.lastLatencyUs = state.raisedUs - value.timestampUs;
+        if (state.lastLatencyUs > state.maxLatencyUs) state.maxLatencyUs = state.lastLatencyUs;
+    }
+    if (worse) state.worst[channel] = value.value;
+    updateOutput();
+    state.version++;
+    seqlock.endWrite();
+
+    if (raise) halWake();               // The UI loop draws it now, not after its idle sleep
+}
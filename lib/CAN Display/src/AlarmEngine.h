@@ -0,0 +1,90 @@
+#pragma once
+#include "Hal.h"
+#include "CANDataManager.h"
+#include "SeqLock.h"
+#include <atomic>
+
+#define ALARM_NO_PIN 0xFF
+
+// Warning and critical thresholds per channel, checked on every decoded value as a
+// ChannelListener, so on the ingest task right after the frame is decoded and not whenever
+// the UI gets around to it. A level is raised once the value has been past its threshold for
+// holdMs (0 = at once) and only drops again once it is back by more than the hysteresis. On a
+// raise the optional output pin goes high right there, and halWake() cuts the UI loop's sleep
+// short so the alarm screen doesn't wait for the next render slot.
+//
+// A raise latches until acknowledged, with the worst level and value since, so a knock spike
+// that is gone by the next frame still gets shown. The pin only follows the live level.
+// Readers use status(), a seqlock copy like LapTimer::status(). acknowledge() is an atomic
+// mask, safe from any core, and a channel that raises again is unacknowledged again.
+
+enum AlarmLevel : uint8_t {
+    ALARM_OK,
+    ALARM_WARNING,
+    ALARM_CRITICAL
+};
+
+// In physical units, like paramList[] shows them
+struct AlarmRule {
+    bool enabled;
+    bool below;                         // Alarm under the thresholds (battery voltage, oil pressure)
+    float warning;
+    float critical;
+    float hysteresis;                   // How far back past a threshold before its level clears
+    uint16_t holdMs;                    // Has to stay past a threshold this long first
+};
+
+struct AlarmStatus {
+    AlarmLevel level[MAX_CHANNELS];     // Now
+    AlarmLevel latched[MAX_CHANNELS];   // Worst since the last acknowledge(), for unacknowledged channels
+    int32_t worst[MAX_CHANNELS];        // Scaled like ChannelValue::value, worst value since then
+    ChannelMask active;                 // level != ALARM_OK
+    ChannelMask unacknowledged;         // Raised since the last acknowledge(), active or not
+    uint32_t raises;
+    uint32_t raisedUs;                  // halMicros() at the latest raise
+    uint32_t lastLatencyUs;             // Frame received -> level raised (and pin set)
+    uint32_t maxLatencyUs;
+    uint32_t version;                   // Changes with every level or worst value change
+
+    // What to flash: the worst unacknowledged channel, -1 = none
+    int shown() const {
+        int best = -1;
+        for (int i = 0; i < MAX_CHANNELS; i++) {
+            if ((unacknowledged >> i) & 1 && (best < 0 || latched[i] > latched[best])) best = i;
+        }
+        return best;
+    }
+};
+
+class AlarmEngine : public ChannelListener {
+public:
+    void begin();                       // Before the listener is registered, rules start disabled
+    void setRule(int channel, const AlarmRule& rule);   // Before the listener is registered too
+    void setOutputPin(uint8_t pin, AlarmLevel atLevel = ALARM_CRITICAL);   // High while any channel is at atLevel or worse
+    void acknowledge(ChannelMask channels) { acked.fetch_or(channels); }
+    void status(AlarmStatus& out) const;
+    void onChannel(int channel, const ChannelValue& value, uint8_t decimals) override;
+
+private:
+    struct Thresholds {
+        uint8_t decimals;               // What the scaled values below are for
+        int32_t warning;                // Scaled, negated for below rules so worse is always higher
+        int32_t critical;
+        int32_t hysteresis;
+    };
+
+    void rescale(int channel, uint8_t decimals);
+    void updateOutput();
+
+    AlarmRule rules[MAX_CHANNELS];
+    Thresholds scaled[MAX_CHANNELS];
+    uint32_t pastSinceUs[MAX_CHANNELS][2];  // Start of the current run past warning / critical
+    uint8_t pastMask[MAX_CHANNELS];     // Bit 0 = past warning, bit 1 = past critical
+    uint8_t outputPin = ALARM_NO_PIN;
+    AlarmLevel outputLevel = ALARM_CRITICAL;
+    bool outputOn = false;
+
+    AlarmStatus state = {};
+    SeqLock seqlock;                    // Held while state is being written
+    std::atomic<ChannelMask> acked{0};
+};
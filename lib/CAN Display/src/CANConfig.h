@@ -0,0 +1,59 @@
+#pragma once
+#include <stdint.h>
+
+#ifndef MAX_CHANNELS
+#define MAX_CHANNELS 12                 // 8 from the bus + 4 derived (paramList[] in screens.cpp)
+#endif
+
+#define CAN_ID_UNASSIGNED 0             // customCANID[] default, never dispatched
+#define CAN_MUX_NONE 0xFF               // CANMux::byte of a channel in every frame of its ID
+#define CAN_STD_ID_COUNT 2048           // 11 bit identifiers, direct lookup
+
+#ifndef CAN_STALE_US
+#define CAN_STALE_US 1000000            // A channel not updated for this long is stale
+#endif
+
+// One bit per channel that a frame feeds
+#if MAX_CHANNELS <= 8
+typedef uint8_t ChannelMask;
+#elif MAX_CHANNELS <= 16
+typedef uint16_t ChannelMask;
+#elif MAX_CHANNELS <= 32
+typedef uint32_t ChannelMask;
+#elif MAX_CHANNELS <= 64
+typedef uint64_t ChannelMask;
+#else
+#error "MAX_CHANNELS > 64 not supported by ChannelMask"
+#endif
+
+// Multiplexed channels share an ID and are only in the frames whose data[byte] is their value,
+// like the ECU's 0x180 with data[0] = 10 or 11. All of them on one ID use the same byte.
+struct CANMux {
+    uint8_t byte;                       // CAN_MUX_NONE = not multiplexed
+    uint8_t value;
+};
+constexpr CANMux CAN_NO_MUX = {CAN_MUX_NONE, 0};
+
+// Index of the lowest set channel bit, mask must be non-zero
+inline int lowestChannel(ChannelMask mask) {
+    return sizeof(ChannelMask) > 4 ? __builtin_ctzll((unsigned long long)mask) : __builtin_ctz((unsigned)mask);
+}
+
+// Latest value of one channel, as stored by CANDataManager
+struct ChannelValue {
+    int32_t value;                      // Physical value * 10^decimals (see CANDataManager::channelDecimals())
+    uint32_t seq;                       // Bumped whenever value changes, 0 = nothing received yet
+    uint32_t timestampUs;               // CANFrame::timestampUs of the last frame carrying the channel
+};
+
+// Every channel at one instant, filled by CANDataManager::snapshot()
+struct ChannelSnapshot {
+    ChannelValue values[MAX_CHANNELS];
+    uint8_t decimals[MAX_CHANNELS];     // values[i].value / 10^decimals[i] = physical value
+    ChannelMask fresh;                  // Received within CAN_STALE_US of takenUs
+    uint32_t takenUs;
+    uint32_t version;                   // Changes whenever anything was decoded or reconfigured
+
+    bool isFresh(int channel) const { return channel >= 0 && channel < MAX_CHANNELS && (fresh >> channel) & 1; }
+    uint32_t seq(int channel) const { return channel >= 0 && channel < MAX_CHANNELS ? values[channel].seq : 0; }
+};
@@ -1,68 +1,369 @@
 #include "CANDataManager.h"
 
-void CANDataManager::begin() {
+#ifdef CAN_SIGNAL_TABLE
+#include "dbc_signals.h"                // Generated by tools/dbc_import.py
+static_assert(DBC_SIGNAL_COUNT <= MAX_CHANNELS, "MAX_CHANNELS smaller than the DBC signal table");
+#endif
+static_assert(HISTORY_CHANNELS <= MAX_CHANNELS, "HISTORY_CHANNELS past MAX_CHANNELS");
+
+// Power-on layout of each channel (matches paramList[] order in screens.cpp), change with setSignal()
+//                                                start len  order                signed  scale   offset
+static const CANSignal DEFAULT_SIGNALS[] = {
+    {  7,  8, ByteOrder::Motorola, false, 1.0f,   0.0f  },      // Knock
+    {  7,  8, ByteOrder::Motorola, false, 1.0f,   0.0f  },      // Boost
+    {  7, 16, ByteOrder::Motorola, false, 0.25f,  0.0f  },      // Eng Rev, (256*d0 + d1) / 4
+    {  7,  8, ByteOrder::Motorola, false, 1.0f,  -40.0f },      // Speed
+    {  7,  8, ByteOrder::Motorola, false, 1.0f,  -40.0f },      // Oil Temp
+    {  7,  8, ByteOrder::Motorola, false, 1.0f,  -40.0f },      // Wtr Temp
+    {  7,  8, ByteOrder::Motorola, false, 1.0f,   0.0f  },      // Air Temp
+    {  7, 16, ByteOrder::Motorola, false, 0.01f,  0.0f  },      // BatVolt, (256*d0 + d1) / 100
+};
+static const int DEFAULT_SIGNAL_COUNT = sizeof(DEFAULT_SIGNALS) / sizeof(DEFAULT_SIGNALS[0]);
+
+void CANDataManager::begin(CANSource* source) {
     // Serial.begin(115200);
+    this->source = source;
     for (int i = 0; i < MAX_CHANNELS; i++) {
-        dataCache[i] = -100;
-        lastUpdate[i] = 0;
-        customCANID[i] = 0;
+        values[i] = ChannelValue{0, 0, 0};
+        customCANID[i] = CAN_ID_UNASSIGNED;
+        customMux[i] = CAN_NO_MUX;
+        setSignal(i, DEFAULT_SIGNALS[i < DEFAULT_SIGNAL_COUNT ? i : 0]);
+    }
+    dispatch.clear();
+
+#ifdef CAN_SIGNAL_TABLE
+    // Channel i = DBC_SIGNALS[i], IDs resolved through the offline perfect hash
+    for (int i = 0; i < DBC_SIGNAL_COUNT; i++) {
+        customCANID[i] = DBC_SIGNALS[i].id;
+        customMux[i] = DBC_SIGNALS[i].mux;
+        setSignal(i, DBC_SIGNALS[i].signal);
+    }
+    staticDispatch = true;
+#endif
+}
+
+bool CANDataManager::startIngestTask(int core, int priority) {
+    if (ingestHandle != nullptr) return true;     // Already running
+    if (source == nullptr) return false;
+
+    ingestRunning = true;
+    ingestHandle = halStartTask(ingestTask, "can_ingest", this, priority, core);
+    if (ingestHandle == nullptr) {
+        ingestRunning = false;
+        return false;
+    }
+    return true;
+}
+
+void CANDataManager::stopIngestTask() {
+    if (ingestHandle == nullptr) return;
+
+    ingestRunning = false;              // Task exits after its current receive() times out
+    halJoinTask(ingestHandle);
+    ingestHandle = nullptr;
+}
+
+void CANDataManager::ingestTask(void* arg) {
+    CANDataManager* self = static_cast<CANDataManager*>(arg);
+    CANFrame frame;
+
+    while (self->ingestRunning) {
+        if (self->source->receive(frame, 100)) {
+            self->ingest(frame);
+            // Whatever else already arrived goes into the same batch
+            for (int i = 1; i < CAN_RING_SIZE - 1 && self->source->receive(frame, 0); i++) {
+                self->ingest(frame);
+            }
+        }
+
+        // Decode here so the UI core only copies snapshots, unless the channel setup is changing
+        self->decoding = true;
+        if (!self->configPending) {
+            self->drain();
+        }
+        self->decoding = false;
+    }
+}
+
+void CANDataManager::ingest(const CANFrame& frame) {
+    rxCount = rxCount + 1;
+    lastFrameTime = halMillis();
+    if (!rxRing.push(frame)) {
+        dropCount = dropCount + 1;
+    }
+}
+
+void CANDataManager::inject(const CANFrame& frame) {
+    ingest(frame);
+}
+
+void CANDataManager::pauseDecode() {
+    configPending = true;
+    while (decoding) {                  // At most one batch, frames queue up in the ring meanwhile
+        halDelay(0);
     }
 }
 
-void CANDataManager::setCustomID(int channel, uint32_t id) {
+void CANDataManager::setCustomID(int channel, uint32_t id, CANMux mux) {
     if (channel >= 0 && channel < MAX_CHANNELS) {
+        pauseDecode();
         customCANID[channel] = id;
+        customMux[channel] = mux;
+        dispatch.rebuild(customCANID, customMux, MAX_CHANNELS);
+        staticDispatch = false;         // Mapping no longer matches the generated table
+        resumeDecode();
     }
 }
 
+bool CANDataManager::setSignal(int channel, const CANSignal& sig) {
+    if (channel < 0 || channel >= MAX_CHANNELS) return false;
+
+    RawDecoder fn = selectDecoder(sig);
+    if (fn == nullptr) return false;
+
+    pauseDecode();
+    seqlock.beginWrite();
+    signal[channel] = sig;
+    decoder[channel] = fn;
+    scaling[channel] = SignalScaling::forSignal(sig);
+    toPhysical[channel] = SCALING_TO_PHYSICAL[scaling[channel].decimals];
+    values[channel] = ChannelValue{0, 0, 0};   // Old value was in the old scaling
+    stats[channel].reset();
+    if (hasHistory(channel)) history[channel].reset();
+    minDLC[channel] = CANSignalLayout::lastByte(sig.startBit, sig.length, sig.order) + 1;
+    derivedMask &= ~((ChannelMask)1 << channel);
+    reconfigured(channel);
+    seqlock.endWrite();
+    resumeDecode();
+    return true;
+}
+
+bool CANDataManager::setDerived(int channel, const DerivedProgram& program) {
+    if (!validChannel(channel) || program.length == 0) return false;
+
+    // Only raw or lower derived inputs, and no lower derived channel may already read this one
+    ChannelMask bit = (ChannelMask)1 << channel;
+    ChannelMask lower = bit - 1;
+    if (program.inputs & derivedMask & ~lower || program.inputs & bit) return false;
+    ChannelMask pending = derivedMask & lower;
+    while (pending) {
+        int i = lowestChannel(pending);
+        pending &= pending - 1;
+        if (derived[i].inputs & bit) return false;
+    }
+
+    pauseDecode();
+    seqlock.beginWrite();
+    derived[channel] = program;
+    derivedMask |= bit;
+    scaling[channel] = SignalScaling{};
+    scaling[channel].decimals = program.decimals;
+    toPhysical[channel] = SCALING_TO_PHYSICAL[program.decimals];
+    values[channel] = ChannelValue{0, 0, 0};
+    stats[channel].reset();
+    if (hasHistory(channel)) history[channel].reset();
+    reconfigured(channel);
+    seqlock.endWrite();
+    resumeDecode();
+    return true;
+}
+
+void CANDataManager::reconfigured(int channel) {
+    derivedInputs = 0;
+    ChannelMask pending = derivedMask;
+    while (pending) {
+        int i = lowestChannel(pending);
+        pending &= pending - 1;
+        derivedInputs |= derived[i].inputs;
+        if ((derived[i].inputs >> channel) & 1) {   // Computed from a value that was in another scaling
+            values[i] = ChannelValue{0, 0, 0};
+            stats[i].reset();
+            if (hasHistory(i)) history[i].reset();
+        }
+    }
+}
+
+void CANDataManager::resetStats(int channel) {
+    pauseDecode();
+    seqlock.beginWrite();
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        if (channel < 0 || channel == i) stats[i].reset();
+    }
+    seqlock.endWrite();
+    resumeDecode();
+}
+
+bool CANDataManager::addListener(ChannelListener* listener) {
+    if (listener == nullptr || listenerCount == MAX_CHANNEL_LISTENERS) return false;
+    pauseDecode();
+    listeners[listenerCount++] = listener;
+    resumeDecode();
+    return true;
+}
+
+void CANDataManager::removeListener(ChannelListener* listener) {
+    pauseDecode();
+    for (int i = 0; i < listenerCount; i++) {
+        if (listeners[i] == listener) {
+            listeners[i] = listeners[--listenerCount];
+            break;
+        }
+    }
+    resumeDecode();
+}
+
 void CANDataManager::update() {
-    twai_message_t message;
+    if (ingestHandle != nullptr) return;   // The ingest task decodes, a second consumer would break the ring
+
+    // No ingest task -> poll the source here like before so update() still works on its own
+    if (source != nullptr) {
+        CANFrame frame;
+        while (source->receive(frame, 0)) {
+            ingest(frame);
+        }
+    }
+    drain();
+}
+
+void CANDataManager::drain() {
+    if (rxRing.empty()) return;
+
+    seqlock.beginWrite();
+    CANFrame frame;
+    while (rxRing.pop(frame)) {
+        decode(frame);
+    }
+    seqlock.endWrite();
+}
+
+void CANDataManager::decode(const CANFrame& frame) {
+#ifdef CAN_SIGNAL_TABLE
+    ChannelMask channels = staticDispatch ? (ChannelMask)dbcChannels(frame.identifier, frame.data, frame.dlc)
+                                          : dispatch.lookup(frame.identifier, frame.data, frame.dlc);
+#else
+    ChannelMask channels = dispatch.lookup(frame.identifier, frame.data, frame.dlc);
+#endif
+    channels &= ~derivedMask;           // Even if someone gave one a CAN ID
+
+    ChannelMask received = 0, changed = 0;
+    while (channels) {
+        int i = lowestChannel(channels);
+        channels &= channels - 1;
+
+        if (frame.dlc < minDLC[i]) continue;
+        ChannelMask bit = (ChannelMask)1 << i;
+        received |= bit;
+        if (publish(i, scaling[i].apply(decoder[i](frame.data, signal[i])), frame.timestampUs)) changed |= bit;
+    }
+
+    if (received & derivedInputs) updateDerived(received, changed, frame.timestampUs);
+}
+
+bool CANDataManager::publish(int channel, int32_t value, uint32_t timestampUs) {
+    ChannelValue& v = values[channel];
+    bool changed = value != v.value || v.seq == 0;
+    if (changed) {
+        v.value = value;
+        if (++v.seq == 0) v.seq = 1;    // 0 is reserved for "never received"
+    }
+    v.timestampUs = timestampUs;
+    stats[channel].add(value, timestampUs);
+    if (hasHistory(channel)) history[channel].add(value, timestampUs);
+    for (int l = 0; l < listenerCount; l++) {
+        listeners[l]->onChannel(channel, v, scaling[channel].decimals);
+    }
+    return changed;
+}
 
-    while (twai_receive(&message, 0) == ESP_OK) {
+void CANDataManager::updateDerived(ChannelMask received, ChannelMask changed, uint32_t timestampUs) {
+    ChannelMask pending = derivedMask;
+    while (pending) {
+        int i = lowestChannel(pending);
+        pending &= pending - 1;
+        const DerivedProgram& program = derived[i];
+        if (!(program.inputs & received)) continue;
+
+        // Only run the program when an input moved, the first time once every input has a value
+        int32_t value = values[i].value;
+        if (values[i].seq == 0) {
+            ChannelMask inputs = program.inputs;
+            while (inputs && values[lowestChannel(inputs)].seq != 0) inputs &= inputs - 1;
+            if (inputs) continue;
+            value = program.evaluate(values, toPhysical);
+        }
+        else if (program.inputs & changed) {
+            value = program.evaluate(values, toPhysical);
+        }
+
+        ChannelMask bit = (ChannelMask)1 << i;
+        received |= bit;                // Higher derived channels may read this one
+        if (publish(i, value, timestampUs)) changed |= bit;
+    }
+}
+
+void CANDataManager::snapshot(ChannelSnapshot& out) const {
+    read(out, nullptr);
+}
+
+void CANDataManager::snapshot(ChannelSnapshot& out, ChannelStatsSnapshot& stats) const {
+    read(out, &stats);
+}
+
+void CANDataManager::read(ChannelSnapshot& out, ChannelStatsSnapshot* statsOut) const {
+    uint32_t version = seqlock.read([&] {
         for (int i = 0; i < MAX_CHANNELS; i++) {
-            if (message.identifier == customCANID[i]) {
-            //if (message.data[0] == customCANID[i]) {
-                switch (i) {
-                    case 0:
-                        dataCache[i] = message.data[0];
-                        break;
-                    case 1:
-                        dataCache[i] = message.data[0];
-                        break;
-                    case 2:
-                        dataCache[i] = (256 * message.data[0] + message.data[1]) / 4.0;
-                        break;
-                    case 3: case 4: case 5:
-                        dataCache[i] = message.data[0] - 40;
-                        break;
-                    case 6:
-                        dataCache[i] = message.data[0];
-                        break;
-                    case 7:
-                        dataCache[i] = (256 * message.data[0] + message.data[1]) / 100.0;
-                        break;
-                    default:
-                        dataCache[i] = 8008;
-                        break;
-                }
-                lastUpdate[i] = millis();
-                // Serial.print("dataCache[%d] = %f", i, dataCache[i]);
+            out.values[i] = values[i];
+            out.decimals[i] = scaling[i].decimals;
+        }
+        if (statsOut) {
+            for (int i = 0; i < MAX_CHANNELS; i++) {
+                stats[i].read(statsOut->channels[i]);
             }
         }
+    });
+
+    // Freshness against one clock reading, not one per channel
+    out.version = version;
+    out.takenUs = halMicros();
+    out.fresh = 0;
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        if (out.values[i].seq != 0 && out.takenUs - out.values[i].timestampUs <= CAN_STALE_US) {
+            out.fresh |= (ChannelMask)1 << i;
+        }
     }
+    if (derivedMask) out.fresh = freshDerived(out.fresh);
 }
 
-float CANDataManager::getData(int channel) {
-    if (channel < 0 || channel >= MAX_CHANNELS) return -100;
-
-    if (millis() - lastUpdate[channel] > 1000) {
-        return -100; // stale
+ChannelMask CANDataManager::freshDerived(ChannelMask fresh) const {
+    ChannelMask pending = derivedMask;
+    while (pending) {
+        int i = lowestChannel(pending);
+        pending &= pending - 1;
+        if (derived[i].inputs & ~fresh) fresh &= ~((ChannelMask)1 << i);   // In order, so it carries up the chain
     }
+    return fresh;
+}
 
-    return dataCache[channel];
+bool CANDataManager::readHistory(int channel, int level, HistoryColumn* out) const {
+    if (!hasHistory(channel)) return false;
+    seqlock.read([&] { history[channel].read(level, out); });   // 1 KB, a batch rarely lands in the middle of it
+    return true;
 }
 
-bool CANDataManager::isDataFresh(int channel) {
-    if (channel < 0 || channel >= MAX_CHANNELS) return false;
-    return millis() - lastUpdate[channel] <= 1000;
+float CANDataManager::getData(int channel) const {
+    if (!validChannel(channel)) return 0;
+    return values[channel].value * toPhysical[channel];
+}
+
+bool CANDataManager::isDataFresh(int channel) const {
+    if (!validChannel(channel) || values[channel].seq == 0) return false;
+    // 32 bit micros wrap every ~71 min, a channel silent for exactly that long reads fresh for a moment
+    if (halMicros() - values[channel].timestampUs > CAN_STALE_US) return false;
+    if (isDerived(channel)) {
+        ChannelMask inputs = derived[channel].inputs;   // Raw or lower derived ones, so this ends
+        for (; inputs; inputs &= inputs - 1) {
+            if (!isDataFresh(lowestChannel(inputs))) return false;
+        }
+    }
+    return true;
 }
@@ -1,19 +1,121 @@
 #pragma once
-#include <Arduino.h>
-#include "driver/twai.h"
+#include "Hal.h"
+#include "CANConfig.h"
+#include "CANDispatch.h"
+#include "CANFilter.h"
+#include "CANFrame.h"
+#include "CANSource.h"
+#include "CANRingBuffer.h"
+#include "CANSignal.h"
+#include "ChannelHistory.h"
+#include "ChannelStats.h"
+#include "DerivedChannel.h"
+#include "SeqLock.h"
+#include <atomic>
 
-#define MAX_CHANNELS 8
+#define MAX_CHANNEL_LISTENERS 4
+
+#ifndef CAN_RING_SIZE
+#define CAN_RING_SIZE 256               // Frames buffered between ingest task and update()
+#endif
+
+#ifndef HISTORY_CHANNELS
+#define HISTORY_CHANNELS (MAX_CHANNELS < 16 ? MAX_CHANNELS : 16)   // Graphed: the first 16, ~3 KB of RAM each
+#endif
+
+// Decoding happens on the ingest task when one runs (update() otherwise), so the channel
+// values are written on core 0 and read by the UI on core 1. Readers use snapshot(): a
+// seqlock copy of every channel, retried if the writer was mid-batch, so an 8 channel screen
+// never shows RPM from one batch and boost from the next. The writer never waits.
+//
+// Every decoded value also goes into the channel's StatsTracker (stint min/max/mean and the
+// 1/10/60 s sliding extrema) and, for the first HISTORY_CHANNELS, ChannelHistory (min/max
+// graph columns), inside the same write, so stats, history and values always agree.
+//
+// A channel given a DerivedProgram with setDerived() is computed instead of decoded. After
+// each frame, a derived channel whose inputs were in it is re-evaluated if one of their seqs
+// changed, and otherwise only has its timestamp, stats, history and listeners updated, the
+// same as a raw channel whose value didn't change. They go in channel order, so a derived
+// channel can read raw channels and lower numbered derived ones, never higher ones. It is
+// fresh while all of its inputs are.
+
+// Gets every decoded value of every channel, on whichever task decodes (the ingest task when
+// it runs), inside the snapshot write. Keep it short and O(1), the next batch waits on it.
+class ChannelListener {
+public:
+    virtual ~ChannelListener() {}
+    virtual void onChannel(int channel, const ChannelValue& value, uint8_t decimals) = 0;
+};
 
 class CANDataManager {
 public:
-    void begin();                       // Initializes internal state
-    void update();                      // Polls CAN bus (non-blocking)
-    float getData(int channel);        // Returns latest cached value
-    bool isDataFresh(int channel);     // True if updated in last 1000ms
-    void setCustomID(int channel, uint32_t id);
+    void begin(CANSource* source = nullptr);   // Initializes internal state, frames come from source
+    bool startIngestTask(int core = 0, int priority = 5);   // Drain the source from its own task (core 0 is idle, loop() runs on core 1)
+    void stopIngestTask();
+    void update();                      // Polls and decodes when no ingest task runs, no-op otherwise (non-blocking)
+    void inject(const CANFrame& frame); // Queue a frame directly (host/replay), only while no ingest task runs
+    void snapshot(ChannelSnapshot& out) const;   // All channels from one consistent point, safe from any core
+    void snapshot(ChannelSnapshot& out, ChannelStatsSnapshot& stats) const;   // Values and their stats from the same point
+    void resetStats(int channel = -1);  // Start a new stint, -1 = every channel
+    bool readHistory(int channel, int level, HistoryColumn* out) const;   // HISTORY_COLUMNS of it, consistent like snapshot(), false past HISTORY_CHANNELS
+    float getData(int channel) const;  // One channel as a float (0 before the first frame), use snapshot() for several
+    bool isDataFresh(int channel) const;   // Received within CAN_STALE_US
+    uint8_t channelDecimals(int channel) const { return validChannel(channel) ? scaling[channel].decimals : 0; }
+    void setCustomID(int channel, uint32_t id, CANMux mux = CAN_NO_MUX);   // Rebuilds the ID dispatch table, pauses decoding meanwhile
+    CANMux getMux(int channel) const { return validChannel(channel) ? customMux[channel] : CAN_NO_MUX; }
+    bool setSignal(int channel, const CANSignal& sig);   // Where in the frame a channel lives, false if it doesn't fit 8 bytes
+    bool setDerived(int channel, const DerivedProgram& program);   // Computed from other channels until setSignal(), false on a loop (see above)
+    bool isDerived(int channel) const { return validChannel(channel) && (derivedMask >> channel) & 1; }
+    const CANSignal& getSignal(int channel) const { return signal[channel]; }
+    bool addListener(ChannelListener* listener);   // false when MAX_CHANNEL_LISTENERS are in, pauses decoding meanwhile
+    void removeListener(ChannelListener* listener);
+    CANAcceptanceFilter acceptanceFilter() const { return computeAcceptanceFilter(customCANID, MAX_CHANNELS); }
+
+    uint32_t framesReceived() const { return rxCount; }
+    uint32_t framesDropped() const { return dropCount; }   // Ring was full when a frame arrived
+    uint32_t lastFrameMillis() const { return lastFrameTime; }
 
 private:
-    float dataCache[MAX_CHANNELS];
-    unsigned long lastUpdate[MAX_CHANNELS];
+    static bool validChannel(int channel) { return channel >= 0 && channel < MAX_CHANNELS; }
+    static bool hasHistory(int channel) { return channel >= 0 && channel < HISTORY_CHANNELS; }
+    static void ingestTask(void* arg);
+    void ingest(const CANFrame& frame); // Producer side, pushes one frame to the ring
+    void drain();                       // Consumer side, decodes the ring as one seqlock write
+    void decode(const CANFrame& frame);
+    void updateDerived(ChannelMask received, ChannelMask changed, uint32_t timestampUs);
+    bool publish(int channel, int32_t value, uint32_t timestampUs);   // Into values[], stats, history and listeners, true if it changed
+    void reconfigured(int channel);     // Restarts what reads channel, recomputes derivedInputs
+    ChannelMask freshDerived(ChannelMask fresh) const;   // fresh without derived channels that have a stale input
+    void read(ChannelSnapshot& out, ChannelStatsSnapshot* stats) const;   // Both snapshot()s, stats skipped if null
+    void pauseDecode();                 // Waits for the ingest task to finish its batch and hold off
+    void resumeDecode() { configPending = false; }
+
+    ChannelValue values[MAX_CHANNELS];
     uint32_t customCANID[MAX_CHANNELS];
+    CANMux customMux[MAX_CHANNELS];
+    CANSignal signal[MAX_CHANNELS];
+    RawDecoder decoder[MAX_CHANNELS];
+    SignalScaling scaling[MAX_CHANNELS];
+    uint8_t minDLC[MAX_CHANNELS];      // Frames shorter than this can't carry the signal
+    StatsTracker stats[MAX_CHANNELS];
+    ChannelHistory history[HISTORY_CHANNELS];
+    DerivedProgram derived[MAX_CHANNELS];
+    float toPhysical[MAX_CHANNELS];     // 10^-decimals, what DerivedProgram::evaluate() reads values[] with
+    ChannelMask derivedMask = 0;
+    ChannelMask derivedInputs = 0;      // Every channel some derived channel reads
+    CANDispatch dispatch;
+    ChannelListener* listeners[MAX_CHANNEL_LISTENERS];
+    uint8_t listenerCount = 0;
+    bool staticDispatch = false;        // CAN_SIGNAL_TABLE builds: use dbcChannels() until setCustomID()
+
+    CANRingBuffer<CANFrame, CAN_RING_SIZE> rxRing;
+    CANSource* source = nullptr;
+    void* ingestHandle = nullptr;       // halStartTask()
+    volatile bool ingestRunning = false;
+    SeqLock seqlock;                    // Held while values[], stats[], history[] or derived[] are being written
+    std::atomic<bool> configPending{false};
+    std::atomic<bool> decoding{false};  // Ingest task inside drain()
+    volatile uint32_t rxCount = 0;
+    volatile uint32_t dropCount = 0;
+    volatile uint32_t lastFrameTime = 0;
 };
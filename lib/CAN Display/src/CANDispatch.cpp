@@ -0,0 +1,91 @@
+#include "CANDispatch.h"
+#include <string.h>
+
+void CANDispatch::clear() {
+    memset(stdSlot, 0, sizeof(stdSlot));
+    memset(extTable, 0, sizeof(extTable));
+    memset(muxTable, 0, sizeof(muxTable));
+    for (int i = 0; i <= MAX_CHANNELS; i++) {
+        slots[i] = Slot{0, CAN_MUX_NONE};
+    }
+    slotCount = 0;
+}
+
+uint8_t CANDispatch::slotFor(uint32_t id) {
+    if (id < CAN_STD_ID_COUNT) {
+        if (stdSlot[id] == 0) {
+            stdSlot[id] = ++slotCount;
+        }
+        return stdSlot[id];
+    }
+
+    uint32_t h = extHash(id);
+    while (extTable[h].slot != 0 && extTable[h].id != id) {
+        h = (h + 1) & (EXT_TABLE_SIZE - 1);
+    }
+    if (extTable[h].slot == 0) {
+        extTable[h].id = id;
+        extTable[h].slot = ++slotCount;
+    }
+    return extTable[h].slot;
+}
+
+CANDispatch::MuxEntry& CANDispatch::muxEntryFor(uint8_t slot, uint8_t value) {
+    uint32_t h = muxHash(slot, value);
+    while (muxTable[h].slot != 0 && (muxTable[h].slot != slot || muxTable[h].value != value)) {
+        h = (h + 1) & (EXT_TABLE_SIZE - 1);
+    }
+    if (muxTable[h].slot == 0) {
+        muxTable[h].slot = slot;
+        muxTable[h].value = value;
+    }
+    return muxTable[h];
+}
+
+void CANDispatch::rebuild(const uint32_t* ids, const CANMux* mux, int count) {
+    clear();
+    if (count > MAX_CHANNELS) count = MAX_CHANNELS;
+
+    for (int ch = 0; ch < count; ch++) {
+        if (ids[ch] == CAN_ID_UNASSIGNED) continue;
+        ChannelMask bit = (ChannelMask)1 << ch;
+        uint8_t slot = slotFor(ids[ch]);
+        if (mux == nullptr || mux[ch].byte == CAN_MUX_NONE) {
+            slots[slot].channels |= bit;
+            continue;
+        }
+        if (slots[slot].muxByte == CAN_MUX_NONE) {
+            slots[slot].muxByte = mux[ch].byte;
+        }
+        else if (slots[slot].muxByte != mux[ch].byte) {
+            continue;                   // One mux byte per ID, the lowest channel's
+        }
+        muxEntryFor(slot, mux[ch].value).channels |= bit;
+    }
+}
+
+ChannelMask CANDispatch::lookup(uint32_t id, const uint8_t* data, uint8_t dlc) const {
+    uint8_t slot = 0;
+    if (id < CAN_STD_ID_COUNT) {
+        slot = stdSlot[id];
+    }
+    else {
+        uint32_t h = extHash(id);
+        while (extTable[h].slot != 0 && extTable[h].id != id) {
+            h = (h + 1) & (EXT_TABLE_SIZE - 1);
+        }
+        slot = extTable[h].slot;
+    }
+
+    // CAN_MUX_NONE is past any DLC, so plain IDs (and frames too short to say) stop here
+    const Slot& s = slots[slot];
+    if (s.muxByte >= dlc) return s.channels;
+
+    uint8_t value = data[s.muxByte];
+    uint32_t h = muxHash(slot, value);
+    while (muxTable[h].slot != 0) {
+        if (muxTable[h].slot == slot && muxTable[h].value == value) return s.channels | muxTable[h].channels;
+        h = (h + 1) & (EXT_TABLE_SIZE - 1);
+    }
+    return s.channels;
+}
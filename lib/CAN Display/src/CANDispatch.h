@@ -0,0 +1,61 @@
+#pragma once
+#include "CANConfig.h"
+
+// Entries of the offline perfect hashes emitted by tools/dbc_import.py
+struct CANDispatchEntry {
+    uint32_t id;                        // CAN_DISPATCH_EMPTY if unused
+    uint64_t channels;                  // In every frame of the ID
+    uint8_t muxByte;                    // CAN_MUX_NONE, or where to find the value for DBC_MUX_DISPATCH
+};
+struct CANMuxDispatchEntry {
+    uint32_t id;                        // CAN_DISPATCH_EMPTY if unused
+    uint8_t value;
+    uint64_t channels;                  // Only in frames with data[muxByte] == value
+};
+#define CAN_DISPATCH_EMPTY 0xFFFFFFFFu
+
+// Maps a CAN frame to every channel it feeds in constant time.
+// 11 bit IDs go through a direct 2048 entry table, anything larger through a
+// small open addressed hash. Either gives the ID's slot: the channels in every frame
+// of it, and for multiplexed IDs the mux byte, whose value then goes through a second
+// small hash keyed on (slot, value). Rebuilt from scratch whenever the ID config changes.
+class CANDispatch {
+public:
+    void clear();
+    void rebuild(const uint32_t* ids, const CANMux* mux, int count);     // ids[channel], CAN_ID_UNASSIGNED skipped, mux may be null
+    ChannelMask lookup(uint32_t id, const uint8_t* data, uint8_t dlc) const;
+
+private:
+    static const int EXT_TABLE_BITS = MAX_CHANNELS <= 16 ? 5 : MAX_CHANNELS <= 32 ? 6 : 7;
+    static const int EXT_TABLE_SIZE = 1 << EXT_TABLE_BITS;   // >= 2x channels keeps probes short
+    static_assert(EXT_TABLE_SIZE >= 2 * MAX_CHANNELS, "EXT_TABLE_SIZE too small for MAX_CHANNELS");
+
+    struct ExtEntry {
+        uint32_t id;
+        uint8_t slot;                                 // 0 = empty
+    };
+    struct Slot {
+        ChannelMask channels;                         // Not multiplexed
+        uint8_t muxByte;                              // CAN_MUX_NONE if nothing on the ID is
+    };
+    struct MuxEntry {
+        uint8_t slot;                                 // 0 = empty
+        uint8_t value;
+        ChannelMask channels;
+    };
+
+    static uint32_t extHash(uint32_t id) {
+        return (id * 2654435761u) >> (32 - EXT_TABLE_BITS);   // Fibonacci hash, top bits
+    }
+    static uint32_t muxHash(uint8_t slot, uint8_t value) {
+        return (((uint32_t)slot << 8 | value) * 2654435761u) >> (32 - EXT_TABLE_BITS);
+    }
+    uint8_t slotFor(uint32_t id);                     // Finds or allocates the slot for id
+    MuxEntry& muxEntryFor(uint8_t slot, uint8_t value);
+
+    uint8_t stdSlot[CAN_STD_ID_COUNT];               // 0 = no channel, else index into slots
+    ExtEntry extTable[EXT_TABLE_SIZE];
+    Slot slots[MAX_CHANNELS + 1];                    // Slot 0 unused, at most one slot per channel
+    MuxEntry muxTable[EXT_TABLE_SIZE];               // At most one entry per channel too
+    uint8_t slotCount = 0;
+};
@@ -0,0 +1,124 @@
+#include "CANFilter.h"
+#include "CANConfig.h"
+
+// One code/mask pair over the bare ID bits, before it is shifted into register layout
+struct IdMatch {
+    uint32_t code;
+    uint32_t dontCare;
+};
+
+static IdMatch cover(const uint32_t* ids, int count, uint32_t groupBits, uint32_t group) {
+    IdMatch m = { 0, 0 };
+    bool first = true;
+    for (int i = 0; i < count; i++) {
+        if (((groupBits >> i) & 1) != group) continue;
+        if (first) { m.code = ids[i]; first = false; }
+        m.dontCare |= ids[i] ^ m.code;
+    }
+    m.code &= ~m.dontCare;
+    return m;
+}
+
+static uint32_t matches(const IdMatch& m) {
+    return 1u << __builtin_popcount(m.dontCare);
+}
+
+// |A u B| of two code/mask sets
+static uint32_t unionMatches(const IdMatch& a, const IdMatch& b) {
+    uint32_t total = matches(a) + matches(b);
+    bool overlap = ((a.code ^ b.code) & ~a.dontCare & ~b.dontCare) == 0;
+    if (overlap) total -= 1u << __builtin_popcount(a.dontCare & b.dontCare);
+    return total;
+}
+
+CANAcceptanceFilter computeAcceptanceFilter(const uint32_t* ids, int count) {
+    CANAcceptanceFilter f = {};
+    f.code = 0;
+    f.mask = 0xFFFFFFFF;
+    f.singleFilter = true;
+    f.acceptAll = true;
+
+    // Distinct IDs only, at most one per channel
+    uint32_t unique[MAX_CHANNELS];
+    int n = 0;
+    bool anyStd = false, anyExt = false;
+    for (int i = 0; i < count && n < MAX_CHANNELS; i++) {
+        if (ids[i] == CAN_ID_UNASSIGNED) continue;
+        bool seen = false;
+        for (int j = 0; j < n; j++) seen |= unique[j] == ids[i];
+        if (seen) continue;
+        unique[n++] = ids[i];
+        if (ids[i] < CAN_STD_ID_COUNT) anyStd = true; else anyExt = true;
+    }
+    f.wantedIDs = n;
+    f.extended = anyExt;
+
+    if (n == 0 || (anyStd && anyExt)) {
+        f.passingIDs = CAN_STD_ID_COUNT + (anyExt ? 0x20000000u : 0);   // Everything gets through
+        return f;
+    }
+    f.acceptAll = false;
+
+    // Dual mode only compares the top 16 bits of an extended ID, drop the rest up front
+    const int dualDrop = anyExt ? 13 : 0;
+    uint32_t dualIds[MAX_CHANNELS];
+    for (int i = 0; i < n; i++) dualIds[i] = unique[i] >> dualDrop;
+
+    IdMatch single = cover(unique, n, 0, 0);
+    uint32_t bestSingle = matches(single);
+
+    // Try every split into two groups (first ID fixed in group 0), fall back to
+    // contiguous splits of the sorted list when there are too many IDs to enumerate
+    IdMatch bestA = single, bestB = single;
+    uint32_t bestDual = 0xFFFFFFFF;
+    if (n <= 12) {
+        for (uint32_t split = 0; split < (1u << (n - 1)); split++) {
+            uint32_t bits = split << 1;
+            IdMatch a = cover(dualIds, n, bits, 0);
+            IdMatch b = bits ? cover(dualIds, n, bits, 1) : a;
+            uint32_t total = unionMatches(a, b);
+            if (total < bestDual) { bestDual = total; bestA = a; bestB = b; }
+        }
+    }
+    else {
+        uint32_t sorted[MAX_CHANNELS];
+        for (int i = 0; i < n; i++) {
+            int j = i;
+            while (j > 0 && sorted[j - 1] > dualIds[i]) { sorted[j] = sorted[j - 1]; j--; }
+            sorted[j] = dualIds[i];
+        }
+        for (int cut = 1; cut < n; cut++) {
+            IdMatch a = cover(sorted, cut, 0, 0);
+            IdMatch b = cover(sorted + cut, n - cut, 0, 0);
+            uint32_t total = unionMatches(a, b);
+            if (total < bestDual) { bestDual = total; bestA = a; bestB = b; }
+        }
+    }
+    if (dualDrop) bestDual <<= dualDrop;    // Each 16 bit pattern lets 2^13 extended IDs through
+
+    if (bestSingle <= bestDual) {
+        f.singleFilter = true;
+        f.passingIDs = bestSingle;
+        if (anyExt) {
+            f.code = single.code << 3;                              // ID[28:0] in [31:3]
+            f.mask = (single.dontCare << 3) | 0x7;                  // RTR + 2 unused
+        }
+        else {
+            f.code = single.code << 21;                             // ID[10:0] in [31:21]
+            f.mask = (single.dontCare << 21) | 0x1FFFFF;            // RTR + data bytes
+        }
+    }
+    else {
+        f.singleFilter = false;
+        f.passingIDs = bestDual;
+        if (anyExt) {
+            f.code = (bestA.code << 16) | (bestB.code & 0xFFFF);   // ID[28:13] per filter
+            f.mask = (bestA.dontCare << 16) | (bestB.dontCare & 0xFFFF);
+        }
+        else {
+            f.code = (bestA.code << 21) | (bestB.code << 5);        // ID[10:0] in [31:21] and [15:5]
+            f.mask = (bestA.dontCare << 21) | (bestB.dontCare << 5) | 0x001F001F;   // RTR + data nibbles
+        }
+    }
+    return f;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+
+// TWAI (SJA1000 style) acceptance filter covering a set of CAN IDs.
+// code/mask are laid out for twai_filter_config_t, mask bit 1 = don't care.
+// Single filter mode matches the full ID with one code/mask pair; dual filter
+// mode gives two independent pairs (extended frames: upper 16 ID bits only).
+struct CANAcceptanceFilter {
+    uint32_t code;
+    uint32_t mask;
+    bool singleFilter;
+    bool acceptAll;                     // No IDs, or standard and extended mixed
+    bool extended;
+    uint32_t wantedIDs;                 // Distinct IDs asked for
+    uint32_t passingIDs;                // IDs the hardware lets through, wanted included
+    uint32_t unwantedIDs() const { return passingIDs - wantedIDs; }
+};
+
+// Tightest single or dual filter for ids[], CAN_ID_UNASSIGNED entries ignored
+CANAcceptanceFilter computeAcceptanceFilter(const uint32_t* ids, int count);
@@ -0,0 +1,234 @@
+#include "CANReplay.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/***************** TRACE PARSING *********************/
+
+static const char* skipSpaces(const char* p) {
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+}
+
+static const char* skipToken(const char* p) {
+    while (*p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+    return p;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// "1436509052.249713" -> microseconds, fraction padded/truncated to 6 digits
+static bool parseTime(const char*& p, uint64_t& timeUs) {
+    if (!isdigit((unsigned char)*p)) return false;
+    uint64_t sec = 0, frac = 0;
+    while (isdigit((unsigned char)*p)) sec = sec * 10 + (*p++ - '0');
+    int digits = 0;
+    if (*p == '.') {
+        p++;
+        while (isdigit((unsigned char)*p)) {
+            if (digits < 6) { frac = frac * 10 + (*p - '0'); digits++; }
+            p++;
+        }
+    }
+    while (digits++ < 6) frac *= 10;
+    timeUs = sec * 1000000ULL + frac;
+    return true;
+}
+
+// Hex ID, returns number of digits (0 = not an ID)
+static int parseId(const char*& p, uint32_t& id) {
+    int n = 0;
+    id = 0;
+    for (int v; (v = hexValue(*p)) >= 0 && n < 8; p++, n++) id = (id << 4) | v;
+    return n;
+}
+
+// "DE AD BE EF" or "DEADBEEF" / "DE.AD.BE.EF", up to 8 bytes
+static int parseBytes(const char* p, uint8_t* data, int maxBytes) {
+    int n = 0;
+    while (n < maxBytes) {
+        while (*p == ' ' || *p == '\t' || *p == '.') p++;
+        int hi = hexValue(p[0]);
+        int lo = hi >= 0 ? hexValue(p[1]) : -1;
+        if (lo < 0) break;
+        data[n++] = (uint8_t)(hi << 4 | lo);
+        p += 2;
+    }
+    return n;
+}
+
+static bool parseCandump(const char* p, CANFrame& frame, uint64_t& timeUs) {
+    timeUs = 0;
+    if (*p == '(') {
+        p++;
+        if (!parseTime(p, timeUs) || *p != ')') return false;
+        p = skipSpaces(p + 1);
+    }
+    p = skipSpaces(skipToken(p));                  // Interface name
+
+    uint32_t id;
+    int digits = parseId(p, id);
+    if (digits == 0) return false;
+    frame.identifier = id;
+    frame.extd = digits > 3 || id > 0x7FF;
+
+    if (*p == '#') {                               // Log format: ID#DATA
+        p++;
+        if (*p == '#') return false;               // CAN FD
+        if (*p == 'R' || *p == 'r') {              // Remote frame, no payload
+            frame.dlc = 0;
+            return true;
+        }
+        frame.dlc = parseBytes(p, frame.data, 8);
+        return true;
+    }
+
+    p = skipSpaces(p);                             // Screen format: ID  [n]  bytes
+    if (*p != '[') return false;
+    int dlc = atoi(p + 1);
+    p = strchr(p, ']');
+    if (p == nullptr || dlc < 0 || dlc > 8) return false;
+    if (strstr(p, "remote request")) dlc = 0;
+    frame.dlc = parseBytes(p + 1, frame.data, dlc);
+    return frame.dlc == dlc;
+}
+
+static bool parseAsc(const char* p, CANFrame& frame, uint64_t& timeUs) {
+    if (!parseTime(p, timeUs)) return false;
+    p = skipSpaces(p);
+    if (!isdigit((unsigned char)*p)) return false;  // Channel number (not "CANFD", "ErrorFrame"...)
+    p = skipSpaces(skipToken(p));
+
+    uint32_t id;
+    if (parseId(p, id) == 0) return false;
+    frame.identifier = id;
+    frame.extd = id > 0x7FF;
+    if (*p == 'x' || *p == 'X') { frame.extd = 1; p++; }
+    if (*p != ' ' && *p != '\t') return false;     // "ErrorFrame" and friends
+
+    p = skipSpaces(p);
+    if (strncmp(p, "Rx", 2) != 0 && strncmp(p, "Tx", 2) != 0) return false;
+    p = skipSpaces(p + 2);
+    if (*p == 'r') {                               // Remote frame
+        frame.dlc = 0;
+        return true;
+    }
+    if (*p != 'd') return false;
+    p = skipSpaces(p + 1);
+    int dlc = hexValue(*p);
+    if (dlc < 0 || dlc > 8) return false;
+    frame.dlc = parseBytes(p + 1, frame.data, dlc);
+    return frame.dlc == dlc;
+}
+
+bool parseTraceLine(const char* line, CANFrame& frame, uint64_t& timeUs) {
+    const char* p = skipSpaces(line);
+    memset(&frame, 0, sizeof(frame));
+
+    if (*p == '(' || isalpha((unsigned char)*p)) {
+        // candump lines start with "(time)" or the interface name, ASC keywords ("date", "base",
+        // "Begin Triggerblock") fall through to parseCandump and fail on the missing ID/#
+        return parseCandump(p, frame, timeUs);
+    }
+    if (isdigit((unsigned char)*p)) {
+        return parseAsc(p, frame, timeUs);
+    }
+    return false;
+}
+
+/***************** LINE SOURCES *********************/
+
+#ifdef ARDUINO
+bool SerialLineReader::readLine(char* buf, size_t len, uint32_t timeoutMs) {
+    uint32_t start = halMillis();
+    for (;;) {
+        while (Serial.available() > 0) {
+            char c = Serial.read();
+            if (c == '\n' || c == '\r') {
+                if (pendingLen == 0) continue;
+                size_t n = pendingLen < len - 1 ? pendingLen : len - 1;
+                memcpy(buf, pending, n);
+                buf[n] = '\0';
+                pendingLen = 0;
+                return true;
+            }
+            if (pendingLen < sizeof(pending)) pending[pendingLen++] = c;
+        }
+        if (halMillis() - start >= timeoutMs) return false;
+        halDelay(1);
+    }
+}
+#else
+FileLineReader::FileLineReader(const char* path) {
+    file = fopen(path, "r");
+}
+
+FileLineReader::~FileLineReader() {
+    if (file) fclose(file);
+}
+
+bool FileLineReader::readLine(char* buf, size_t len, uint32_t timeoutMs) {
+    if (file == nullptr || fgets(buf, len, file) == nullptr) {
+        atEnd = true;
+        return false;
+    }
+    return true;
+}
+#endif
+
+/***************** REPLAY *********************/
+
+CANReplaySource::CANReplaySource(LineReader& reader, Pacing pacing, float speed)
+    : reader(reader), pacing(pacing), speed(speed > 0 ? speed : 1.0f) {
+    if (pacing == RecordedTiming) this->speed = 1.0f;
+}
+
+bool CANReplaySource::loadNext(uint32_t timeoutMs) {
+    char line[128];
+    while (!havePending) {
+        if (!reader.readLine(line, sizeof(line), timeoutMs)) return false;
+        if (parseTraceLine(line, pendingFrame, pendingTimeUs)) {
+            havePending = true;
+        }
+        else {
+            skipped++;
+        }
+    }
+    return true;
+}
+
+bool CANReplaySource::receive(CANFrame& frame, uint32_t timeoutMs) {
+    if (!loadNext(timeoutMs)) return false;
+
+    if (!started) {
+        started = true;
+        firstTraceUs = pendingTimeUs;
+        startMicros = halMicros();
+    }
+
+    if (pacing != AsFastAsPossible) {
+        // When this frame is due, relative to the first one and scaled by speed
+        uint64_t traceOffset = pendingTimeUs > firstTraceUs ? pendingTimeUs - firstTraceUs : 0;
+        uint32_t dueUs = (uint32_t)(traceOffset / speed);
+        uint32_t nowUs = halMicros() - startMicros;
+        if ((int32_t)(dueUs - nowUs) > 0) {
+            uint32_t waitMs = (dueUs - nowUs + 999) / 1000;
+            if (waitMs > timeoutMs) {
+                halDelay(timeoutMs);
+                return false;
+            }
+            halDelay(waitMs);
+        }
+    }
+
+    frame = pendingFrame;
+    frame.timestampUs = halMicros();
+    havePending = false;
+    replayed++;
+    return true;
+}
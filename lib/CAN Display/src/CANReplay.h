@@ -0,0 +1,78 @@
+#pragma once
+#include "Hal.h"
+#include "CANSource.h"
+
+// Replays recorded traces as a CANSource, so CANDataManager can't tell it from the bus.
+// Understands candump (-l log format and the default/-ta screen format) and Vector ASC.
+//   (1436509052.249713) can0 180#0B11220033       candump -l
+//   (0.000123)  can0  180   [4]  0B 11 22 00      candump -ta
+//      0.012345 1  180             Rx   d 4 0B 11 22 00   ASC (x suffix = extended ID)
+
+// Parses one trace line, false for headers/comments/error frames/CAN FD
+bool parseTraceLine(const char* line, CANFrame& frame, uint64_t& timeUs);
+
+// Where trace lines come from
+class LineReader {
+public:
+    virtual ~LineReader() {}
+    virtual bool readLine(char* buf, size_t len, uint32_t timeoutMs) = 0;   // false on timeout/EOF
+    virtual bool eof() const { return false; }
+};
+
+#ifdef ARDUINO
+// Lines streamed over USB serial, e.g. `cat session.log > /dev/ttyACM0`
+class SerialLineReader : public LineReader {
+public:
+    bool readLine(char* buf, size_t len, uint32_t timeoutMs) override;
+
+private:
+    char pending[96];
+    size_t pendingLen = 0;
+};
+#else
+class FileLineReader : public LineReader {
+public:
+    explicit FileLineReader(const char* path);
+    ~FileLineReader();
+    bool isOpen() const { return file != nullptr; }
+    bool readLine(char* buf, size_t len, uint32_t timeoutMs) override;
+    bool eof() const override { return file == nullptr || atEnd; }
+
+private:
+    FILE* file;
+    bool atEnd = false;
+};
+#endif
+
+class CANReplaySource : public CANSource {
+public:
+    enum Pacing {
+        RecordedTiming,                 // Same gaps as the recording (speed 1.0)
+        Scaled,                         // Recorded gaps divided by speed
+        AsFastAsPossible                // No waiting, for throughput tests
+    };
+
+    explicit CANReplaySource(LineReader& reader, Pacing pacing = RecordedTiming, float speed = 1.0f);
+    bool receive(CANFrame& frame, uint32_t timeoutMs) override;
+    bool finished() const { return !havePending && reader.eof(); }
+
+    uint32_t framesReplayed() const { return replayed; }
+    uint32_t linesSkipped() const { return skipped; }
+
+private:
+    bool loadNext(uint32_t timeoutMs);
+
+    LineReader& reader;
+    Pacing pacing;
+    float speed;
+
+    CANFrame pendingFrame;
+    uint64_t pendingTimeUs = 0;
+    bool havePending = false;
+
+    bool started = false;
+    uint64_t firstTraceUs = 0;          // Recording time of the first frame
+    uint32_t startMicros = 0;           // halMicros() when it was replayed
+    uint32_t replayed = 0;
+    uint32_t skipped = 0;
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Single producer / single consumer lock-free ring.
+// One task may push() and one (other) task may pop(), no locking needed.
+// N must be a power of two, one slot is kept free to tell full from empty.
+template <typename T, size_t N>
+class CANRingBuffer {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "CANRingBuffer size must be a power of two");
+
+public:
+    bool push(const T& item) {          // Producer side, false if full
+        const uint32_t head = headIdx.load(std::memory_order_relaxed);
+        const uint32_t next = (head + 1) & (N - 1);
+        if (next == tailIdx.load(std::memory_order_acquire)) {
+            return false;
+        }
+        slots[head] = item;
+        headIdx.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {                 // Consumer side, false if empty
+        const uint32_t tail = tailIdx.load(std::memory_order_relaxed);
+        if (tail == headIdx.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = slots[tail];
+        tailIdx.store((tail + 1) & (N - 1), std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        return (headIdx.load(std::memory_order_acquire) - tailIdx.load(std::memory_order_acquire)) & (N - 1);
+    }
+
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return N - 1; }
+
+private:
+    T slots[N];
+    std::atomic<uint32_t> headIdx{0};
+    std::atomic<uint32_t> tailIdx{0};
+};
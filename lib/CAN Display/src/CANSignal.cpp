@@ -0,0 +1,120 @@
+#include "CANSignal.h"
+#include <math.h>
+
+using namespace CANSignalLayout;
+
+uint32_t extractRaw(const uint8_t* data, const CANSignal& sig) {
+    const uint8_t first = firstByte(sig.startBit, sig.length, sig.order);
+    const uint8_t last = lastByte(sig.startBit, sig.length, sig.order);
+    uint64_t bytes = 0;
+
+    if (sig.order == ByteOrder::Intel) {
+        for (int b = last; b >= first; b--) bytes = (bytes << 8) | data[b];
+    }
+    else {
+        for (int b = first; b <= last; b++) bytes = (bytes << 8) | data[b];
+    }
+    return (uint32_t)(bytes >> shift(sig.startBit, sig.length, sig.order)) & mask(sig.length);
+}
+
+int64_t decodeRawGeneric(const uint8_t* data, const CANSignal& sig) {
+    uint32_t raw = extractRaw(data, sig);
+    return sig.isSigned ? (int64_t)signExtend(raw, sig.length) : (int64_t)raw;
+}
+
+// Tables of specialized decoders, indexed by start byte
+#define CAN_BYTE_DECODERS(BITS, ORDER, SIGNED, MSB) \
+    { decodeRaw<0 + MSB, BITS, ORDER, SIGNED>, decodeRaw<8 + MSB, BITS, ORDER, SIGNED>, \
+      decodeRaw<16 + MSB, BITS, ORDER, SIGNED>, decodeRaw<24 + MSB, BITS, ORDER, SIGNED>, \
+      decodeRaw<32 + MSB, BITS, ORDER, SIGNED>, decodeRaw<40 + MSB, BITS, ORDER, SIGNED>, \
+      decodeRaw<48 + MSB, BITS, ORDER, SIGNED> }
+
+static const RawDecoder u8Decoders[8] = {
+    decodeRaw<0, 8, ByteOrder::Intel, false>, decodeRaw<8, 8, ByteOrder::Intel, false>,
+    decodeRaw<16, 8, ByteOrder::Intel, false>, decodeRaw<24, 8, ByteOrder::Intel, false>,
+    decodeRaw<32, 8, ByteOrder::Intel, false>, decodeRaw<40, 8, ByteOrder::Intel, false>,
+    decodeRaw<48, 8, ByteOrder::Intel, false>, decodeRaw<56, 8, ByteOrder::Intel, false>
+};
+static const RawDecoder s8Decoders[8] = {
+    decodeRaw<0, 8, ByteOrder::Intel, true>, decodeRaw<8, 8, ByteOrder::Intel, true>,
+    decodeRaw<16, 8, ByteOrder::Intel, true>, decodeRaw<24, 8, ByteOrder::Intel, true>,
+    decodeRaw<32, 8, ByteOrder::Intel, true>, decodeRaw<40, 8, ByteOrder::Intel, true>,
+    decodeRaw<48, 8, ByteOrder::Intel, true>, decodeRaw<56, 8, ByteOrder::Intel, true>
+};
+static const RawDecoder u16beDecoders[7] = CAN_BYTE_DECODERS(16, ByteOrder::Motorola, false, 7);
+static const RawDecoder s16beDecoders[7] = CAN_BYTE_DECODERS(16, ByteOrder::Motorola, true, 7);
+static const RawDecoder u16leDecoders[7] = CAN_BYTE_DECODERS(16, ByteOrder::Intel, false, 0);
+static const RawDecoder s16leDecoders[7] = CAN_BYTE_DECODERS(16, ByteOrder::Intel, true, 0);
+
+RawDecoder selectDecoder(const CANSignal& sig) {
+    if (!fits(sig)) return nullptr;
+
+    // A whole byte reads the same in either byte order
+    if (sig.length == 8 && shift(sig.startBit, sig.length, sig.order) == 0) {
+        uint8_t b = firstByte(sig.startBit, sig.length, sig.order);
+        return sig.isSigned ? s8Decoders[b] : u8Decoders[b];
+    }
+
+    if (sig.length == 16) {
+        uint8_t b = sig.startBit / 8;
+        if (sig.order == ByteOrder::Motorola && sig.startBit % 8 == 7) {
+            return sig.isSigned ? s16beDecoders[b] : u16beDecoders[b];
+        }
+        if (sig.order == ByteOrder::Intel && sig.startBit % 8 == 0) {
+            return sig.isSigned ? s16leDecoders[b] : u16leDecoders[b];
+        }
+    }
+
+    return decodeRawGeneric;
+}
+
+/***************** SCALING *********************/
+
+const int32_t SCALING_POW10[SCALING_MAX_DECIMALS + 1] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+const float SCALING_TO_PHYSICAL[SCALING_MAX_DECIMALS + 1] = {1.0f, 0.1f, 0.01f, 0.001f, 0.0001f, 0.00001f, 0.000001f};
+
+#define SIGNAL_MAX_DECIMALS 4           // What forSignal() picks, so a 32 bit raw value still fits once scaled
+
+static bool isWhole(float v) {
+    return fabsf(v - roundf(v)) <= 1e-4f * (fabsf(v) > 1.0f ? fabsf(v) : 1.0f) && fabsf(v) < 2147483647.0f;
+}
+
+SignalScaling SignalScaling::forSignal(const CANSignal& sig) {
+    SignalScaling s = {};
+    for (int d = 0; d <= SIGNAL_MAX_DECIMALS; d++) {
+        float mul = sig.scale * SCALING_POW10[d];
+        float add = sig.offset * SCALING_POW10[d];
+        if (isWhole(mul) && isWhole(add)) {
+            s.decimals = d;
+            s.exact = true;
+            s.mul = (int32_t)lroundf(mul);
+            s.add = (int32_t)lroundf(add);
+            return s;
+        }
+    }
+
+    // One raw step should still be worth at least 10 counts
+    int d = 0;
+    while (d < SIGNAL_MAX_DECIMALS && fabsf(sig.scale) * SCALING_POW10[d] < 10.0f) d++;
+    s.decimals = d;
+    s.exact = false;
+    s.scale = sig.scale * SCALING_POW10[d];
+    s.offset = sig.offset * SCALING_POW10[d];
+    return s;
+}
+
+int32_t SignalScaling::apply(int64_t raw) const {
+    int64_t v;
+    if (exact) {
+        v = raw * mul + add;
+    }
+    else {
+        float f = raw * scale + offset;
+        if (f >= 2147483520.0f) return INT32_MAX;
+        if (f <= -2147483520.0f) return -INT32_MAX;
+        v = (int64_t)(f < 0 ? f - 0.5f : f + 0.5f);
+    }
+    if (v > INT32_MAX) return INT32_MAX;
+    if (v < -INT32_MAX) return -INT32_MAX;
+    return (int32_t)v;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <stdint.h>
+#include "CANConfig.h"
+
+// Describes where a value lives in a CAN payload and how to scale it, DBC style:
+//   physical = raw * scale + offset
+// startBit follows DBC numbering: the LSB for Intel (little endian, @1),
+// the MSB for Motorola (big endian, @0). Lengths up to 32 bits.
+enum class ByteOrder : uint8_t {
+    Intel,                              // Little endian
+    Motorola                            // Big endian
+};
+
+struct CANSignal {
+    uint8_t startBit;
+    uint8_t length;
+    ByteOrder order;
+    bool isSigned;
+    float scale;
+    float offset;
+};
+
+// One named signal of a message, as emitted by tools/dbc_import.py
+struct CANSignalDef {
+    const char* name;
+    const char* unit;
+    uint32_t id;
+    CANSignal signal;
+    CANMux mux;                         // From the DBC's M / mN markers
+};
+
+// Returns the raw signal value (sign extended if isSigned), before scale/offset
+typedef int64_t (*RawDecoder)(const uint8_t* data, const CANSignal& sig);
+
+namespace CANSignalLayout {
+
+// Bit position counted from the MSB of data[0] (Motorola) / LSB of data[0] (Intel)
+constexpr uint8_t motorolaMsb(uint8_t startBit) { return (startBit / 8) * 8 + (7 - startBit % 8); }
+
+constexpr uint8_t firstByte(uint8_t startBit, uint8_t length, ByteOrder order) {
+    return order == ByteOrder::Intel ? startBit / 8 : motorolaMsb(startBit) / 8;
+}
+constexpr uint8_t lastByte(uint8_t startBit, uint8_t length, ByteOrder order) {
+    return order == ByteOrder::Intel ? (startBit + length - 1) / 8 : (motorolaMsb(startBit) + length - 1) / 8;
+}
+// Right shift that drops the bits below the signal once its bytes are assembled
+constexpr uint8_t shift(uint8_t startBit, uint8_t length, ByteOrder order) {
+    return order == ByteOrder::Intel ? startBit % 8 : 7 - (motorolaMsb(startBit) + length - 1) % 8;
+}
+constexpr uint32_t mask(uint8_t length) {
+    return length >= 32 ? 0xFFFFFFFFu : (1u << length) - 1;
+}
+
+constexpr bool fits(const CANSignal& sig) {
+    return sig.length >= 1 && sig.length <= 32 && lastByte(sig.startBit, sig.length, sig.order) < 8;
+}
+
+// Unrolled at compile time, so a fixed layout touches only its own bytes
+template <int First, int Last>
+struct LoadBE {
+    static inline uint64_t load(const uint8_t* d) { return (LoadBE<First, Last - 1>::load(d) << 8) | d[Last]; }
+};
+template <int First>
+struct LoadBE<First, First> {
+    static inline uint64_t load(const uint8_t* d) { return d[First]; }
+};
+
+template <int First, int Last>
+struct LoadLE {
+    static inline uint64_t load(const uint8_t* d) { return (LoadLE<First + 1, Last>::load(d) << 8) | d[First]; }
+};
+template <int Last>
+struct LoadLE<Last, Last> {
+    static inline uint64_t load(const uint8_t* d) { return d[Last]; }
+};
+
+inline int32_t signExtend(uint32_t raw, uint8_t length) {
+    return length >= 32 ? (int32_t)raw : (int32_t)(raw << (32 - length)) >> (32 - length);
+}
+
+} // namespace CANSignalLayout
+
+// Compile-time specialized extraction: shift, mask and byte range are constants
+template <uint8_t Start, uint8_t Len, ByteOrder Order>
+inline uint32_t extractRaw(const uint8_t* data) {
+    using namespace CANSignalLayout;
+    static_assert(Len >= 1 && Len <= 32, "signal length must be 1..32 bits");
+    static_assert(lastByte(Start, Len, Order) < 8, "signal runs past the 8 byte payload");
+
+    constexpr int first = firstByte(Start, Len, Order);
+    constexpr int last = lastByte(Start, Len, Order);
+    uint64_t bytes = Order == ByteOrder::Intel ? LoadLE<first, last>::load(data) : LoadBE<first, last>::load(data);
+    return (uint32_t)(bytes >> shift(Start, Len, Order)) & mask(Len);
+}
+
+template <uint8_t Start, uint8_t Len, ByteOrder Order, bool Signed>
+int64_t decodeRaw(const uint8_t* data, const CANSignal& sig) {
+    uint32_t raw = extractRaw<Start, Len, Order>(data);
+    return Signed ? (int64_t)CANSignalLayout::signExtend(raw, Len) : (int64_t)raw;
+}
+
+// Generic fallback for layouts only known at runtime
+uint32_t extractRaw(const uint8_t* data, const CANSignal& sig);
+int64_t decodeRawGeneric(const uint8_t* data, const CANSignal& sig);
+
+inline float physicalValue(int64_t raw, const CANSignal& sig) { return raw * sig.scale + sig.offset; }
+
+// Most decimals any scaled value can have: signals, derived channels, alarms, formatting
+#define SCALING_MAX_DECIMALS 6
+extern const int32_t SCALING_POW10[SCALING_MAX_DECIMALS + 1];       // 10^decimals
+extern const float SCALING_TO_PHYSICAL[SCALING_MAX_DECIMALS + 1];   // 10^-decimals, scaled value -> physical
+
+// Physical value as a scaled integer (value * 10^decimals), so storing and printing it needs no floats.
+// decimals is the fewest that represent scale and offset exactly (0.25 -> 2, -40 -> 0), then
+// it's pure integer math. Scales like 1/256 fall back to float with enough decimals for ~2 digits per step.
+struct SignalScaling {
+    uint8_t decimals;
+    bool exact;
+    int32_t mul, add;                   // exact: value = raw * mul + add
+    float scale, offset;                // otherwise: value = round(raw * scale + offset), both * 10^decimals
+
+    static SignalScaling forSignal(const CANSignal& sig);
+    int32_t apply(int64_t raw) const;   // Saturates at +-INT32_MAX
+};
+
+// Picks a specialized decoder for common byte aligned 8/16 bit layouts, else decodeRawGeneric
+RawDecoder selectDecoder(const CANSignal& sig);
@@ -0,0 +1,73 @@
+#include "ChannelHistory.h"
+
+static const HistoryColumn EMPTY_COLUMN = {INT32_MAX, INT32_MIN};
+static const uint32_t COLUMN_US = HISTORY_COLUMN_MS * 1000;
+
+static void widen(HistoryColumn& column, const HistoryColumn& with) {
+    if (with.min < column.min) column.min = with.min;
+    if (with.max > column.max) column.max = with.max;
+}
+
+void ChannelHistory::reset() {
+    for (int level = 0; level < HISTORY_LEVELS; level++) {
+        for (int i = 0; i < HISTORY_COLUMNS; i++) {
+            columns[level][i] = EMPTY_COLUMN;
+        }
+        open[level] = EMPTY_COLUMN;
+        head[level] = 0;
+        folded[level] = 0;
+    }
+    columnStartUs = 0;
+    started = false;
+}
+
+void ChannelHistory::advance(int level, uint32_t count) {
+    // Only the last screen of what's closed here stays in the ring
+    uint32_t written = count < HISTORY_COLUMNS ? count : HISTORY_COLUMNS;
+    uint32_t at = (head[level] + count - written) % HISTORY_COLUMNS;
+    for (uint32_t i = 0; i < written; i++) {
+        columns[level][(at + i) % HISTORY_COLUMNS] = i == 0 && written == count ? open[level] : EMPTY_COLUMN;
+    }
+    head[level] = (head[level] + count) % HISTORY_COLUMNS;
+
+    // Only the first of them has anything in it, the rest just count towards closing the next level
+    if (level + 1 < HISTORY_LEVELS) {
+        widen(open[level + 1], open[level]);
+        uint32_t total = folded[level + 1] + count;
+        folded[level + 1] = total % HISTORY_DECIMATION;
+        if (total >= HISTORY_DECIMATION) advance(level + 1, total / HISTORY_DECIMATION);
+    }
+    open[level] = EMPTY_COLUMN;
+}
+
+void ChannelHistory::add(int32_t value, uint32_t nowUs) {
+    if (!started) {
+        started = true;
+        columnStartUs = nowUs;
+    }
+
+    // Close every column that ended since the last frame, a gap in one go
+    uint32_t elapsed = (nowUs - columnStartUs) / COLUMN_US;
+    if (elapsed > 0) {
+        advance(0, elapsed);
+        columnStartUs += elapsed * COLUMN_US;
+    }
+
+    if (value < open[0].min) open[0].min = value;
+    if (value > open[0].max) open[0].max = value;
+}
+
+void ChannelHistory::read(int level, HistoryColumn* out) const {
+    if (level < 0) level = 0;
+    if (level >= HISTORY_LEVELS) level = HISTORY_LEVELS - 1;
+
+    // The open column is still filling, so the closed ones lose their oldest to make room
+    for (int i = 0; i < HISTORY_COLUMNS - 1; i++) {
+        out[i] = columns[level][(head[level] + 1 + i) % HISTORY_COLUMNS];
+    }
+    HistoryColumn last = open[level];
+    for (int below = 0; below < level; below++) {
+        widen(last, open[below]);       // The parts of it that haven't been folded in yet
+    }
+    out[HISTORY_COLUMNS - 1] = last;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+
+#define HISTORY_COLUMNS 128             // One per pixel across the panel
+#define HISTORY_LEVELS 3
+#ifndef HISTORY_COLUMN_MS
+#define HISTORY_COLUMN_MS 125           // Level 0 column, 128 of them = 16 s
+#endif
+#define HISTORY_DECIMATION 4            // Level n + 1 columns per level n column: 16 s, 64 s, 256 s
+
+// One column of a graph: everything the channel did in that time, min > max = no frames.
+// Keeping both ends instead of an average is what lets a knock spike survive decimation.
+struct HistoryColumn {
+    int32_t min;
+    int32_t max;
+
+    bool empty() const { return min > max; }
+};
+
+// The last HISTORY_COLUMNS columns of a channel at each level, as fixed rings. A frame
+// only widens the open level 0 column. When it closes it goes into the ring and is folded
+// into level 1's open column, which closes after HISTORY_DECIMATION of them, and so on, so
+// a frame costs O(1) and the coarse levels never rescan anything. Columns follow the
+// frame timestamps: a gap in the frames leaves empty columns, written straight into each
+// ring (at most one screen of them per level) instead of closing them one by one.
+class ChannelHistory {
+public:
+    void reset();
+    void add(int32_t value, uint32_t nowUs);
+    void read(int level, HistoryColumn* out) const;   // HISTORY_COLUMNS, oldest first, the open column last
+
+    static uint32_t columnMs(int level) {
+        uint32_t ms = HISTORY_COLUMN_MS;
+        for (int i = 0; i < level; i++) ms *= HISTORY_DECIMATION;
+        return ms;
+    }
+
+private:
+    void advance(int level, uint32_t count);   // Close open[level] and count - 1 empty columns after it
+
+    HistoryColumn columns[HISTORY_LEVELS][HISTORY_COLUMNS];
+    HistoryColumn open[HISTORY_LEVELS];
+    uint8_t head[HISTORY_LEVELS];       // Next column written = oldest one
+    uint8_t folded[HISTORY_LEVELS];     // Lower level columns in open[level]
+    uint32_t columnStartUs;
+    bool started;
+};
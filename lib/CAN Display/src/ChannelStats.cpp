@@ -0,0 +1,65 @@
+#include "ChannelStats.h"
+
+void WindowExtrema::reset(uint32_t windowUs) {
+    this->windowUs = windowUs;
+    bucketUs = windowUs / STATS_BUCKETS;
+    mins.head = mins.count = 0;
+    maxs.head = maxs.count = 0;
+    bucketStartUs = 0;
+    bucketMin = 0;
+    bucketMax = 0;
+    bucketOpen = false;
+}
+
+void WindowExtrema::expire(uint32_t nowUs) {
+    while (mins.count && nowUs - mins.front().startUs >= windowUs) mins.popFront();
+    while (maxs.count && nowUs - maxs.front().startUs >= windowUs) maxs.popFront();
+}
+
+void WindowExtrema::add(int32_t value, uint32_t nowUs) {
+    if (bucketOpen && nowUs - bucketStartUs < bucketUs) {
+        if (value < bucketMin) bucketMin = value;
+        if (value > bucketMax) bucketMax = value;
+        return;
+    }
+
+    // Close the running bucket. Whatever it beats at the back can never be the extreme again.
+    // Old buckets only leave here too, the window can't move by less than a bucket anyway
+    expire(nowUs);
+    if (bucketOpen && nowUs - bucketStartUs < windowUs) {
+        while (mins.count && mins.back().value >= bucketMin) mins.popBack();
+        mins.pushBack(Bucket{bucketStartUs, bucketMin});
+        while (maxs.count && maxs.back().value <= bucketMax) maxs.popBack();
+        maxs.pushBack(Bucket{bucketStartUs, bucketMax});
+    }
+    bucketOpen = true;
+    bucketStartUs = nowUs;
+    bucketMin = value;
+    bucketMax = value;
+}
+
+void StatsTracker::reset() {
+    current = ChannelStats{};
+    for (int w = 0; w < STATS_WINDOWS; w++) {
+        windows[w].reset(STATS_WINDOW_US[w]);
+    }
+}
+
+void StatsTracker::add(int32_t value, uint32_t nowUs) {
+    if (current.count == 0 || value < current.min) current.min = value;
+    if (current.count == 0 || value > current.max) current.max = value;
+    current.sum += value;
+    current.count++;
+
+    for (int w = 0; w < STATS_WINDOWS; w++) {
+        windows[w].add(value, nowUs);
+    }
+}
+
+void StatsTracker::read(ChannelStats& out) const {
+    out = current;
+    for (int w = 0; w < STATS_WINDOWS; w++) {
+        out.windowMin[w] = windows[w].min();
+        out.windowMax[w] = windows[w].max();
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "CANConfig.h"
+#include <stdint.h>
+
+#define STATS_WINDOWS 3
+#ifndef STATS_BUCKETS
+#define STATS_BUCKETS 20                // Per window, windows slide in steps of window / STATS_BUCKETS
+#endif
+
+enum StatsWindow : uint8_t {
+    STATS_1S,
+    STATS_10S,
+    STATS_60S
+};
+
+static const uint32_t STATS_WINDOW_US[STATS_WINDOWS] = {1000000, 10000000, 60000000};
+
+// What a reader gets per channel, values scaled like ChannelValue::value
+struct ChannelStats {
+    int32_t min;                        // Since the last resetStats() (the stint)
+    int32_t max;
+    int64_t sum;
+    uint32_t count;                     // Decoded frames, 0 = no stats yet
+    int32_t windowMin[STATS_WINDOWS];   // Over the last 1 s / 10 s / 60 s of frames
+    int32_t windowMax[STATS_WINDOWS];
+
+    int32_t mean() const { return count ? (int32_t)(sum / (int64_t)count) : 0; }
+};
+
+// Sliding min and max over the last windowUs. Frames are folded into buckets of
+// windowUs / STATS_BUCKETS, closed buckets go through a monotonic deque each for min
+// and max, so memory is fixed no matter the frame rate and a frame costs O(1) amortized:
+// two compares, plus the deque work once per bucket. The window's edge moves in whole
+// buckets (50 ms for the 1 s window), and only while frames arrive.
+class WindowExtrema {
+public:
+    void reset(uint32_t windowUs);
+    void add(int32_t value, uint32_t nowUs);
+    int32_t min() const { return mins.count && mins.front().value < bucketMin ? mins.front().value : bucketMin; }
+    int32_t max() const { return maxs.count && maxs.front().value > bucketMax ? maxs.front().value : bucketMax; }
+
+private:
+    struct Bucket {
+        uint32_t startUs;
+        int32_t value;
+    };
+
+    // Ring of buckets, front = oldest. Never holds more than one window of buckets
+    struct Deque {
+        Bucket items[STATS_BUCKETS + 1];
+        uint8_t head;
+        uint8_t count;
+
+        const Bucket& front() const { return items[head]; }
+        const Bucket& back() const { return items[(head + count - 1) % (STATS_BUCKETS + 1)]; }
+        void popFront() { head = (head + 1) % (STATS_BUCKETS + 1); count--; }
+        void popBack() { count--; }
+        void pushBack(const Bucket& b) { items[(head + count) % (STATS_BUCKETS + 1)] = b; count++; }
+    };
+
+    void expire(uint32_t nowUs);
+
+    Deque mins;                         // Increasing values
+    Deque maxs;                         // Decreasing values
+    uint32_t windowUs;
+    uint32_t bucketUs;
+    uint32_t bucketStartUs;
+    int32_t bucketMin;
+    int32_t bucketMax;
+    bool bucketOpen;
+};
+
+// Everything for one channel, fed with every decoded value. The window extrema are put
+// together in read(), so the writer never pays for them
+class StatsTracker {
+public:
+    void reset();
+    void add(int32_t value, uint32_t nowUs);
+    void read(ChannelStats& out) const;
+
+private:
+    ChannelStats current;               // Window fields unused
+    WindowExtrema windows[STATS_WINDOWS];
+};
+
+// Stats of every channel from one consistent point, see CANDataManager::snapshot()
+struct ChannelStatsSnapshot {
+    ChannelStats channels[MAX_CHANNELS];
+};
@@ -0,0 +1,283 @@
+#include "DataLogger.h"
+#include <string.h>
+
+static_assert(sizeof(LogBlockHeader) % 4 == 0, "LogRecord after the header has to stay aligned");
+static_assert(LOG_CHANNELS <= 32, "LogRecord::fresh is 32 bits, the delta tag has 5 bits of channel");
+
+static const uint32_t SAMPLE_PERIOD_MS = 1000 / LOG_RATE_HZ;
+
+bool DataLogger::begin(LogStorage* storage, CANDataManager* source) {
+    this->storage = storage;
+    this->source = source;
+    pending[0] = false;
+    pending[1] = false;
+    active = 0;
+    blockOpen = false;
+    logged = loggedBytes = dropped = written = errors = 0;
+    lastFlushUs = maxFlushUs = meanFlushUs = 0;
+    totalFlushUs = 0;
+    if (!storage->begin() || storage->blockSize() != LOG_BLOCK_SIZE) return false;
+    blocks = storage->capacity() / LOG_BLOCK_SIZE;
+    if (blocks < 2) return false;
+
+    // Continue the sequence where the newest block left it
+    bool found = false;
+    uint32_t lastSequence = 0;
+    uint16_t lastSession = 0;
+    for (uint32_t i = 0; i < blocks; i++) {
+        LogBlockHeader h;
+        if (!storage->read(i * LOG_BLOCK_SIZE, &h, sizeof(h)) || h.magic != LOG_BLOCK_MAGIC) continue;
+        if (!found || (int32_t)(h.sequence - lastSequence) > 0) {
+            lastSequence = h.sequence;
+            lastSession = h.session;
+        }
+        found = true;
+    }
+    nextSequence = found ? lastSequence + 1 : 0;
+    sessionId = found ? lastSession + 1 : 1;
+    return true;
+}
+
+bool DataLogger::start(int samplerCore, int samplerPriority, int writerCore, int writerPriority) {
+    if (samplerHandle != nullptr) return true;
+    if (blocks == 0) return false;      // begin() failed
+
+    writerRunning = true;
+    writerHandle = halStartTask(writerTask, "log_write", this, writerPriority, writerCore);
+    if (writerHandle == nullptr) {
+        writerRunning = false;
+        return false;
+    }
+    samplerRunning = true;
+    samplerHandle = halStartTask(samplerTask, "log_sample", this, samplerPriority, samplerCore);
+    if (samplerHandle == nullptr) {
+        samplerRunning = false;
+        writerRunning = false;
+        halJoinTask(writerHandle);
+        writerHandle = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void DataLogger::stop() {
+    if (samplerHandle == nullptr) return;
+
+    samplerRunning = false;
+    halJoinTask(samplerHandle);
+    samplerHandle = nullptr;
+
+    // Sampler is gone, the partial block can be sealed from here. If the writer still has the
+    // other buffer, wait for it rather than drop the tail of the session.
+    if (blockOpen) {
+        while (pending[active ^ 1]) halDelay(1);
+        seal();
+    }
+    writerRunning = false;              // Writes whatever is pending, then exits
+    halJoinTask(writerHandle);
+    writerHandle = nullptr;
+}
+
+void DataLogger::setDeadband(int channel, int32_t deadband) {
+    if (channel >= 0 && channel < LOG_CHANNELS) this->deadband[channel] = deadband < 0 ? 0 : deadband;
+}
+
+LoggerStats DataLogger::stats() const {
+    LoggerStats s;
+    s.samplesLogged = logged;
+    s.samplesDropped = dropped;
+    s.bytesLogged = loggedBytes;
+    s.blocksWritten = written;
+    s.bytesWritten = written * LOG_BLOCK_SIZE;
+    s.flushErrors = errors;
+    s.lastFlushUs = lastFlushUs;
+    s.maxFlushUs = maxFlushUs;
+    s.meanFlushUs = meanFlushUs;
+    return s;
+}
+
+void DataLogger::samplerTask(void* arg) {
+    DataLogger* self = static_cast<DataLogger*>(arg);
+    uint32_t nextMs = halMillis();
+
+    while (self->samplerRunning) {
+        self->sample(halMillis());
+
+        nextMs += SAMPLE_PERIOD_MS;
+        int32_t waitMs = (int32_t)(nextMs - halMillis());
+        if (waitMs > 0) {
+            halDelay(waitMs);
+        }
+        else if (waitMs < -(int32_t)SAMPLE_PERIOD_MS) {
+            nextMs = halMillis();       // Starved for a while, don't catch up in a burst
+        }
+    }
+}
+
+void DataLogger::sample(uint32_t nowMs) {
+    source->snapshot(snap);
+    bool sealWanted = flushRequested.exchange(false);
+
+    if (snap.fresh == 0) {
+        // Nothing on the bus (ignition off), don't fill the flash with stale values. Whatever
+        // was collected goes out now, in case the power goes next.
+        if (blockOpen && !pending[active ^ 1]) seal();
+        return;
+    }
+    if (blockOpen && memcmp(header(active)->decimals, snap.decimals, sizeof(header(active)->decimals)) != 0) {
+        if (pending[active ^ 1]) {      // Can't seal, and the scaling in this block would be wrong
+            dropped = dropped + 1;
+            return;
+        }
+        seal();
+    }
+    if (!blockOpen && !open()) {
+        dropped = dropped + 1;
+        return;
+    }
+
+    uint16_t before = header(active)->records ? fill : 0;      // A new block's header counts too
+    if (format == LOG_FORMAT_RAW) {
+        appendRaw(nowMs);
+    }
+    else {
+        appendDelta(nowMs);
+    }
+    logged = logged + 1;
+    loggedBytes = loggedBytes + fill - before;
+
+    size_t space = LOG_BLOCK_SIZE - fill;
+    size_t needed = format == LOG_FORMAT_RAW ? sizeof(LogRecord) : (size_t)LOG_DELTA_TICK_MAX;   // Room for the next sample
+    if (space < needed || (sealWanted && !pending[active ^ 1])) {
+        seal();
+    }
+}
+
+void DataLogger::appendRaw(uint32_t nowMs) {
+    LogRecord record;
+    record.timeMs = nowMs;
+    record.fresh = (uint32_t)snap.fresh;
+    for (int i = 0; i < LOG_CHANNELS; i++) {
+        record.values[i] = snap.values[i].value;
+    }
+    memcpy(buffers[active] + fill, &record, sizeof(record));
+    fill += sizeof(record);
+    header(active)->records++;
+}
+
+void DataLogger::appendDelta(uint32_t nowMs) {
+    LogBlockHeader* h = header(active);
+
+    if (h->records == 0 || nowMs - lastKeyframeMs >= LOG_KEYFRAME_MS) {
+        put(LOG_TAG_KEYFRAME);
+        putVarint(nowMs);
+        putVarint((uint32_t)snap.fresh);
+        for (int i = 0; i < LOG_CHANNELS; i++) {
+            lastValue[i] = snap.values[i].value;
+            lastSeq[i] = snap.values[i].seq;
+            putSigned(lastValue[i]);
+        }
+        lastFresh = (uint32_t)snap.fresh;
+        lastTickMs = nowMs;
+        lastKeyframeMs = nowMs;
+        h->records++;
+        return;
+    }
+
+    // Only the first record of this sample carries the time
+    uint8_t tick = LOG_TAG_TICK;
+    for (int i = 0; i < LOG_CHANNELS; i++) {
+        const ChannelValue& v = snap.values[i];
+        if (v.seq == lastSeq[i]) continue;
+        lastSeq[i] = v.seq;
+        int32_t delta = v.value - lastValue[i];
+        if (delta <= deadband[i] && delta >= -deadband[i]) continue;
+
+        put(LOG_TAG_DELTA | tick | i);
+        if (tick) putVarint(nowMs - lastTickMs);
+        putSigned(delta);
+        lastValue[i] = v.value;
+        tick = 0;
+        h->records++;
+    }
+    uint32_t fresh = (uint32_t)snap.fresh;
+    if (fresh != lastFresh) {
+        put(LOG_TAG_FRESH | tick);
+        if (tick) putVarint(nowMs - lastTickMs);
+        putVarint(fresh);
+        lastFresh = fresh;
+        tick = 0;
+        h->records++;
+    }
+    if (!tick) lastTickMs = nowMs;
+}
+
+void DataLogger::putVarint(uint32_t value) {
+    while (value >= 0x80) {
+        put((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    put((uint8_t)value);
+}
+
+bool DataLogger::open() {
+    if (pending[active].load(std::memory_order_acquire)) return false;
+
+    uint8_t* buffer = buffers[active];
+    memset(buffer, 0xFF, LOG_BLOCK_SIZE);   // Unused tail stays erased
+    LogBlockHeader* h = header(active);
+    h->magic = LOG_BLOCK_MAGIC;
+    h->sequence = nextSequence++;
+    h->session = sessionId;
+    h->format = format;
+    h->channels = LOG_CHANNELS;
+    h->records = 0;
+    h->rateHz = LOG_RATE_HZ;
+    memcpy(h->decimals, snap.decimals, sizeof(h->decimals));
+    fill = sizeof(LogBlockHeader);
+    blockOpen = true;
+    return true;
+}
+
+void DataLogger::seal() {
+    pending[active].store(true, std::memory_order_release);
+    active ^= 1;
+    blockOpen = false;
+}
+
+void DataLogger::writerTask(void* arg) {
+    DataLogger* self = static_cast<DataLogger*>(arg);
+
+    while (self->writerRunning || self->pending[0] || self->pending[1]) {
+        if (!self->writePending()) {
+            halDelay(LOG_WRITER_POLL_MS);
+        }
+    }
+}
+
+bool DataLogger::writePending() {
+    // Oldest first when both are waiting
+    int which = -1;
+    for (int i = 0; i < 2; i++) {
+        if (!pending[i].load(std::memory_order_acquire)) continue;
+        if (which < 0 || (int32_t)(header(i)->sequence - header(which)->sequence) < 0) which = i;
+    }
+    if (which < 0) return false;
+
+    uint32_t offset = (header(which)->sequence % blocks) * LOG_BLOCK_SIZE;
+    uint32_t start = halMicros();
+    bool ok = storage->writeBlock(offset, buffers[which]);
+    uint32_t us = halMicros() - start;
+    pending[which].store(false, std::memory_order_release);
+
+    if (!ok) {
+        errors = errors + 1;
+        return true;
+    }
+    written = written + 1;
+    lastFlushUs = us;
+    if (us > maxFlushUs) maxFlushUs = us;
+    totalFlushUs += us;
+    meanFlushUs = (uint32_t)(totalFlushUs / written);
+    return true;
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include "Hal.h"
+#include "CANDataManager.h"
+#include "LogStorage.h"
+#include <atomic>
+
+#ifndef LOG_RATE_HZ
+#define LOG_RATE_HZ 100                 // Samples per second
+#endif
+#define LOG_BLOCK_SIZE 4096             // One flash erase block, what each RAM buffer holds
+#define LOG_BLOCK_MAGIC 0x314C4343      // "CCL1"
+#define LOG_FORMAT_RAW 1                // LogRecord after LogRecord
+#define LOG_FORMAT_DELTA 2              // Tagged varint records, see below
+#ifndef LOG_KEYFRAME_MS
+#define LOG_KEYFRAME_MS 1000            // Delta format: all channels in full at least this often
+#endif
+#define LOG_WRITER_POLL_MS 20
+#define LOG_CHANNELS (MAX_CHANNELS < 32 ? MAX_CHANNELS : 32)   // Logged: the first 32, the tag has 5 bits of channel
+
+// Samples every channel from CANDataManager::snapshot() at LOG_RATE_HZ into one of two
+// block sized RAM buffers. A full buffer is handed to a low priority writer task that puts
+// it into the next erase block of the log area while sampling carries on in the other one,
+// so neither the ingest task nor loop() ever waits on flash. If the writer is still busy with
+// the other buffer when this one fills up, samples are dropped (and counted), never blocked on.
+// The log area is a ring: block n goes to (sequence % blocks), the oldest is overwritten.
+//
+// LOG_FORMAT_DELTA (the default) only stores what changed. Every record starts with a tag byte:
+//   bits 0-4  channel
+//   bit 5     LOG_TAG_TICK: a varint of ms since the previous tick follows (first record of a sample)
+//   bits 6-7  LOG_TAG_DELTA:    zig-zag varint of value - last value of that channel
+//             LOG_TAG_KEYFRAME: varint time ms, varint fresh mask, zig-zag varint value of every channel
+//             LOG_TAG_FRESH:    [tick] varint fresh mask, when a channel went stale or came back
+// Varints are 7 bits per byte, low first. Every block starts with a keyframe and the deltas only
+// refer back to the same block, so each block (and each keyframe) decodes on its own. A channel
+// is only written when its sequence number moved and the value left the deadband around the
+// last value written. tools/log_decode.py turns a dump into CSV.
+
+// Start of every block, so a dump decodes without knowing where the ring started
+#define LOG_TAG_TICK 0x20
+#define LOG_TAG_DELTA 0x00
+#define LOG_TAG_KEYFRAME 0x40
+#define LOG_TAG_FRESH 0x80
+#define LOG_TAG_END 0xFF                // Erased flash after the last record
+#define LOG_DELTA_TICK_MAX (6 * LOG_CHANNELS + 16)   // Worst case bytes one sample can add
+
+struct LogBlockHeader {
+    uint32_t magic;
+    uint32_t sequence;                  // +1 per block, across sessions too
+    uint16_t session;                   // +1 per begin()
+    uint8_t format;
+    uint8_t channels;                   // LOG_CHANNELS of the firmware that wrote it
+    uint16_t records;                   // Samples (raw) or tagged records (delta)
+    uint16_t rateHz;
+    uint8_t decimals[LOG_CHANNELS];     // A block is sealed early when these change
+};
+
+struct LogRecord {
+    uint32_t timeMs;                    // halMillis()
+    uint32_t fresh;                     // ChannelSnapshot::fresh of the logged channels
+    int32_t values[LOG_CHANNELS];       // Scaled like ChannelValue::value
+};
+
+struct LoggerStats {
+    uint32_t samplesLogged;
+    uint32_t samplesDropped;            // Both buffers were full, the writer fell behind
+    uint32_t bytesLogged;               // Headers + records, what the format costs
+    uint32_t bytesWritten;              // Whole blocks
+    uint32_t blocksWritten;
+    uint32_t flushErrors;
+    uint32_t lastFlushUs;               // Erase + program of one block
+    uint32_t maxFlushUs;
+    uint32_t meanFlushUs;
+};
+
+class DataLogger {
+public:
+    bool begin(LogStorage* storage, CANDataManager* source);   // Picks up after the last session, false if there is no log area
+    void setFormat(uint8_t format) { this->format = format; }   // LOG_FORMAT_RAW/DELTA, before start()
+    void setDeadband(int channel, int32_t deadband);   // Delta format: changes up to this (scaled, like ChannelValue::value) aren't written
+    bool start(int samplerCore = 1, int samplerPriority = 2, int writerCore = 0, int writerPriority = 1);
+    void stop();                        // Writes out the partial block too
+    void flush() { flushRequested = true; }   // Seal the partial block at the next sample
+    bool running() const { return samplerHandle != nullptr; }
+    uint16_t session() const { return sessionId; }
+    uint32_t blockCount() const { return blocks; }
+    LoggerStats stats() const;
+
+private:
+    static void samplerTask(void* arg);
+    static void writerTask(void* arg);
+    void sample(uint32_t nowMs);
+    bool open();                        // Start a block in the active buffer, false if it's still being written
+    void appendRaw(uint32_t nowMs);
+    void appendDelta(uint32_t nowMs);
+    void put(uint8_t byte) { buffers[active][fill++] = byte; }
+    void putVarint(uint32_t value);
+    void putSigned(int32_t value) { putVarint(((uint32_t)value << 1) ^ (uint32_t)(value >> 31)); }   // Zig-zag
+    void seal();                        // Hand the active buffer to the writer, switch to the other
+    bool writePending();                // Writer side, false if there was nothing to write
+    LogBlockHeader* header(int buffer) { return reinterpret_cast<LogBlockHeader*>(buffers[buffer]); }
+
+    LogStorage* storage = nullptr;
+    CANDataManager* source = nullptr;
+    uint32_t blocks = 0;
+    uint32_t nextSequence = 0;
+    uint16_t sessionId = 0;
+
+    alignas(4) uint8_t buffers[2][LOG_BLOCK_SIZE];
+    std::atomic<bool> pending[2];       // Sealed, owned by the writer until it clears this
+    int active = 0;                     // Buffer the sampler fills
+    bool blockOpen = false;
+    uint16_t fill = 0;                  // Bytes used in the active buffer
+    uint8_t format = LOG_FORMAT_DELTA;
+    ChannelSnapshot snap;
+
+    // Delta format state, reset by the keyframe at the start of every block
+    int32_t deadband[LOG_CHANNELS] = {};
+    int32_t lastValue[LOG_CHANNELS];    // As last written
+    uint32_t lastSeq[LOG_CHANNELS];     // As last looked at
+    uint32_t lastFresh = 0;
+    uint32_t lastTickMs = 0;
+    uint32_t lastKeyframeMs = 0;
+    std::atomic<bool> flushRequested{false};
+
+    void* samplerHandle = nullptr;      // halStartTask()
+    void* writerHandle = nullptr;
+    volatile bool samplerRunning = false;
+    volatile bool writerRunning = false;
+
+    volatile uint32_t logged = 0;
+    volatile uint32_t loggedBytes = 0;
+    volatile uint32_t dropped = 0;
+    volatile uint32_t written = 0;      // Blocks
+    volatile uint32_t errors = 0;
+    volatile uint32_t lastFlushUs = 0;
+    volatile uint32_t maxFlushUs = 0;
+    volatile uint32_t meanFlushUs = 0;
+    uint64_t totalFlushUs = 0;          // Writer only
+};
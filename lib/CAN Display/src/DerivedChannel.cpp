@@ -0,0 +1,196 @@
+#include "DerivedChannel.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Recursive descent straight to postfix, tracking the stack depth as it goes:
+//   expr    = term { (+|-) term }
+//   term    = unary { (*|/) unary }
+//   unary   = - unary | primary
+//   primary = number | $channel | min(expr, expr) | max(expr, expr) | abs(expr) | (expr)
+struct DerivedCompiler {
+    const char* p;
+    DerivedProgram& out;
+    int depth = 0;
+    int constantCount = 0;
+    bool ok = true;
+
+    DerivedCompiler(const char* expr, DerivedProgram& out) : p(expr), out(out) {}
+
+    void skipSpaces() {
+        while (*p == ' ' || *p == '\t') p++;
+    }
+
+    bool accept(char c) {
+        skipSpaces();
+        if (*p != c) return false;
+        p++;
+        return true;
+    }
+
+    void expect(char c) {
+        if (!accept(c)) ok = false;
+    }
+
+    void emit(uint8_t byte) {
+        if (out.length == DERIVED_CODE_SIZE) {
+            ok = false;
+            return;
+        }
+        out.code[out.length++] = byte;
+    }
+
+    void push(uint8_t op, uint8_t arg) {
+        emit(op);
+        emit(arg);
+        if (++depth > DERIVED_STACK) ok = false;
+    }
+
+    void binary(uint8_t op) {
+        emit(op);
+        depth--;
+    }
+
+    void expr() {
+        term();
+        while (ok) {
+            if (accept('+')) { term(); binary(DOP_ADD); }
+            else if (accept('-')) { term(); binary(DOP_SUB); }
+            else break;
+        }
+    }
+
+    void term() {
+        unary();
+        while (ok) {
+            if (accept('*')) { unary(); binary(DOP_MUL); }
+            else if (accept('/')) { unary(); binary(DOP_DIV); }
+            else break;
+        }
+    }
+
+    void unary() {
+        if (accept('-')) {
+            unary();
+            emit(DOP_NEG);
+            return;
+        }
+        primary();
+    }
+
+    void primary() {
+        skipSpaces();
+        if (!ok) return;
+
+        if (*p == '$') {
+            p++;
+            if (!isdigit((unsigned char)*p)) {
+                ok = false;
+                return;
+            }
+            int channel = (int)strtol(p, (char**)&p, 10);
+            if (channel >= MAX_CHANNELS) {
+                ok = false;
+                return;
+            }
+            out.inputs |= (ChannelMask)1 << channel;
+            push(DOP_CHANNEL, (uint8_t)channel);
+        }
+        else if (isdigit((unsigned char)*p) || *p == '.') {
+            const char* start = p;
+            float value = strtof(start, (char**)&p);
+            if (p == start) {
+                ok = false;
+                return;
+            }
+            int index = 0;
+            while (index < constantCount && out.constants[index] != value) index++;   // Same constant twice shares the slot
+            if (index == constantCount) {
+                if (constantCount == DERIVED_CONSTANTS) {
+                    ok = false;
+                    return;
+                }
+                out.constants[constantCount++] = value;
+            }
+            push(DOP_CONST, (uint8_t)index);
+        }
+        else if (strncmp(p, "min", 3) == 0 || strncmp(p, "max", 3) == 0) {
+            uint8_t op = p[1] == 'i' ? DOP_MIN : DOP_MAX;
+            p += 3;
+            expect('(');
+            expr();
+            expect(',');
+            expr();
+            expect(')');
+            binary(op);
+        }
+        else if (strncmp(p, "abs", 3) == 0) {
+            p += 3;
+            expect('(');
+            expr();
+            expect(')');
+            emit(DOP_ABS);
+        }
+        else if (accept('(')) {
+            expr();
+            expect(')');
+        }
+        else {
+            ok = false;
+        }
+    }
+};
+
+bool DerivedProgram::compile(const char* expr, uint8_t decimals, int* errorAt) {
+    length = 0;
+    this->decimals = decimals < SCALING_MAX_DECIMALS ? decimals : SCALING_MAX_DECIMALS;
+    inputs = 0;
+    for (int i = 0; i < DERIVED_CONSTANTS; i++) {
+        constants[i] = 0.0f;
+    }
+
+    DerivedCompiler compiler(expr, *this);
+    compiler.expr();
+    compiler.skipSpaces();
+    if (*compiler.p != '\0') compiler.ok = false;
+    if (!compiler.ok) {
+        if (errorAt) *errorAt = (int)(compiler.p - expr);
+        length = 0;
+        inputs = 0;
+        return false;
+    }
+    return true;
+}
+
+int32_t DerivedProgram::evaluate(const ChannelValue* values, const float* toPhysical) const {
+    float stack[DERIVED_STACK];
+    int top = -1;
+
+    for (int pc = 0; pc < length; pc++) {
+        switch (code[pc]) {
+        case DOP_CHANNEL: {
+            uint8_t channel = code[++pc];
+            stack[++top] = values[channel].value * toPhysical[channel];
+            break;
+        }
+        case DOP_CONST:
+            stack[++top] = constants[code[++pc]];
+            break;
+        case DOP_ADD: top--; stack[top] += stack[top + 1]; break;
+        case DOP_SUB: top--; stack[top] -= stack[top + 1]; break;
+        case DOP_MUL: top--; stack[top] *= stack[top + 1]; break;
+        case DOP_DIV: top--; stack[top] = stack[top + 1] != 0.0f ? stack[top] / stack[top + 1] : 0.0f; break;
+        case DOP_MIN: top--; stack[top] = fminf(stack[top], stack[top + 1]); break;
+        case DOP_MAX: top--; stack[top] = fmaxf(stack[top], stack[top + 1]); break;
+        case DOP_NEG: stack[top] = -stack[top]; break;
+        case DOP_ABS: stack[top] = fabsf(stack[top]); break;
+        }
+    }
+
+    // Scaled and saturated like SignalScaling::apply()
+    float scaled = stack[0] * SCALING_POW10[decimals];
+    if (!(scaled > -2147483520.0f)) return scaled != scaled ? 0 : -INT32_MAX;   // NaN -> 0
+    if (scaled >= 2147483520.0f) return INT32_MAX;
+    return (int32_t)lroundf(scaled);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "CANConfig.h"
+#include "CANSignal.h"
+
+#define DERIVED_CODE_SIZE 24            // Bytes of bytecode, a channel or constant push is 2
+#define DERIVED_CONSTANTS 6
+#define DERIVED_STACK 6
+
+// A channel the ECU doesn't send, computed from ones it does: "$1 * 14.504" (boost in psi),
+// "$4 - $5", "$2 / max($3, 1)". $n is channel n in physical units, like paramList[] shows
+// it. + - * / and parentheses, unary minus, min(a, b), max(a, b) and abs(a). x / 0 is 0.
+//
+// compile() parses once at config time into a postfix bytecode over a small float stack, with
+// the stack depth checked then, so evaluate() is a flat loop with no parsing, allocation or
+// bounds checks. CANDataManager::setDerived() runs it whenever an input's seq changes.
+
+enum DerivedOp : uint8_t {
+    DOP_CHANNEL,                        // Next byte: channel to push
+    DOP_CONST,                          // Next byte: constants[] index to push
+    DOP_ADD,                            // Pop b, pop a, push a op b
+    DOP_SUB,
+    DOP_MUL,
+    DOP_DIV,
+    DOP_MIN,
+    DOP_MAX,
+    DOP_NEG,                            // Pop a, push op a
+    DOP_ABS,
+};
+
+struct DerivedProgram {
+    uint8_t code[DERIVED_CODE_SIZE];
+    uint8_t length;
+    uint8_t decimals;                   // Of the result, like SignalScaling::decimals
+    ChannelMask inputs;                 // Every $n it reads
+    float constants[DERIVED_CONSTANTS];
+
+    // false if expr doesn't parse or doesn't fit, errorAt = offset into expr where it went wrong
+    bool compile(const char* expr, uint8_t decimals, int* errorAt = nullptr);
+    // toPhysical[i] = 10^-decimals of channel i, result scaled like ChannelValue::value
+    int32_t evaluate(const ChannelValue* values, const float* toPhysical) const;
+};
@@ -0,0 +1,75 @@
+#include "FixedFormat.h"
+
+static int copyOut(char* out, size_t size, const char* text, int len, uint8_t width) {
+    if (size == 0) return 0;
+    int pad = width > len ? width - len : 0;
+    int total = pad + len;
+    if (total > (int)size - 1) total = size - 1;
+
+    int i = 0;
+    for (; i < pad && i < total; i++) out[i] = ' ';
+    for (int j = 0; i < total; i++, j++) out[i] = text[j];
+    out[total] = '\0';
+    return total;
+}
+
+int formatScaled(char* out, size_t size, int32_t scaled, uint8_t decimals, uint8_t width) {
+    if (decimals > FIXED_MAX_DECIMALS) decimals = FIXED_MAX_DECIMALS;
+
+    bool negative = scaled < 0;
+    uint32_t magnitude = negative ? 0u - (uint32_t)scaled : (uint32_t)scaled;
+
+    // Clamp to the field: digits available = width - sign - point
+    if (width > 0) {
+        int digits = width - (negative ? 1 : 0) - (decimals ? 1 : 0);
+        if (digits < decimals + 1) digits = decimals + 1;
+        if (digits < 10) {
+            uint32_t limit = 1;
+            for (int i = 0; i < digits; i++) limit *= 10;
+            if (magnitude >= limit) magnitude = limit - 1;
+        }
+    }
+
+    // Digits right to left, at least one before the point
+    char text[16];
+    int pos = sizeof(text);
+    int emitted = 0;
+    do {
+        if (decimals && emitted == decimals) text[--pos] = '.';
+        text[--pos] = '0' + magnitude % 10;
+        magnitude /= 10;
+        emitted++;
+    } while (magnitude > 0 || emitted <= decimals);
+
+    if (negative) text[--pos] = '-';         // scaled != 0 here, so never "-0"
+    return copyOut(out, size, text + pos, sizeof(text) - pos, width);
+}
+
+int32_t rescaleFixed(int32_t scaled, uint8_t fromDecimals, uint8_t toDecimals) {
+    if (fromDecimals > FIXED_MAX_DECIMALS) fromDecimals = FIXED_MAX_DECIMALS;
+    if (toDecimals > FIXED_MAX_DECIMALS) toDecimals = FIXED_MAX_DECIMALS;
+    if (toDecimals >= fromDecimals) {
+        int64_t v = (int64_t)scaled * SCALING_POW10[toDecimals - fromDecimals];
+        return v > INT32_MAX ? INT32_MAX : v < -INT32_MAX ? -INT32_MAX : (int32_t)v;
+    }
+    int32_t div = SCALING_POW10[fromDecimals - toDecimals];
+    return scaled < 0 ? -((-(int64_t)scaled + div / 2) / div) : (scaled + (int64_t)div / 2) / div;
+}
+
+int formatFixed(char* out, size_t size, float value, uint8_t decimals, uint8_t width) {
+    if (decimals > FIXED_MAX_DECIMALS) decimals = FIXED_MAX_DECIMALS;
+    if (value != value) {               // NaN
+        return copyOut(out, size, "---", 3, width);
+    }
+
+    // Whole and fractional parts separately, value * 10^d in one float loses digits past 2^24
+    if (value >= 2147483520.0f) return formatScaled(out, size, INT32_MAX, decimals, width);     // Largest float below 2^31
+    if (value <= -2147483520.0f) return formatScaled(out, size, -INT32_MAX, decimals, width);
+    int32_t whole = (int32_t)value;
+    float fraction = (value - whole) * SCALING_POW10[decimals];
+    int64_t scaled = (int64_t)whole * SCALING_POW10[decimals] + (int32_t)(fraction < 0 ? fraction - 0.5f : fraction + 0.5f);
+
+    if (scaled > INT32_MAX) scaled = INT32_MAX;
+    if (scaled < -INT32_MAX) scaled = -INT32_MAX;
+    return formatScaled(out, size, (int32_t)scaled, decimals, width);
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "CANSignal.h"
+
+// Integer-only replacement for sprintf("%.Nf") on the render path: no float printf,
+// no heap, no locale. Values are rounded half away from zero to `decimals` places
+// (max FIXED_MAX_DECIMALS), "-0.0" prints as "0.0", NaN prints as "---".
+//
+// width > 0 right-aligns into that many characters, values that don't fit are
+// clamped to the widest that does ("999.9", "-99.9") instead of overflowing the field.
+// Everything returns the string length, out is always terminated.
+
+#define FIXED_MAX_DECIMALS SCALING_MAX_DECIMALS
+
+int formatFixed(char* out, size_t size, float value, uint8_t decimals, uint8_t width = 0);
+
+// Same, for a value already scaled by 10^decimals (1234 with 2 decimals = "12.34")
+int formatScaled(char* out, size_t size, int32_t scaled, uint8_t decimals, uint8_t width = 0);
+
+// Moves a scaled value between decimal counts, rounding half away from zero when dropping digits
+int32_t rescaleFixed(int32_t scaled, uint8_t fromDecimals, uint8_t toDecimals);
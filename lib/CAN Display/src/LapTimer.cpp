@@ -0,0 +1,165 @@
+#include "LapTimer.h"
+#include <string.h>
+
+static const uint32_t STEP_MM = LAP_REF_STEP_M * 1000;
+
+void LapTimer::begin(int speedChannel) {
+    this->speedChannel = speedChannel;
+    triggerPending = false;
+    resetPending = false;
+    seqlock.beginWrite();
+    clear();
+    seqlock.endWrite();
+}
+
+void LapTimer::setTrackLength(uint32_t meters) {
+    trackLengthMm = meters * 1000;
+}
+
+bool LapTimer::setSectors(const uint32_t* endsM, int count) {
+    if (count < 0 || count > LAP_MAX_SECTORS - 1) return false;
+    for (int i = 0; i < count; i++) {
+        if (i > 0 && endsM[i] <= endsM[i - 1]) return false;
+        sectorEndMm[i] = endsM[i] * 1000;
+    }
+    sectorCount = count;
+    seqlock.beginWrite();
+    state.sectors = count + 1;
+    seqlock.endWrite();
+    return true;
+}
+
+void LapTimer::status(LapStatus& out) const {
+    seqlock.read([&] { out = state; });
+}
+
+void LapTimer::clear() {
+    state = LapStatus{};
+    state.sectors = sectorCount + 1;
+    haveSpeed = false;
+    remainder = 0;
+    distanceMm = 0;
+    sectorStartMs = 0;
+    bestPoints = 0;
+    currentPoints = 0;
+}
+
+void LapTimer::startLap(uint32_t atUs, uint32_t carryMm) {
+    state.running = true;
+    state.startUs = atUs;
+    state.lapMs = 0;
+    state.sector = 0;
+    state.deltaValid = false;
+    memset(state.sectorMs, 0, sizeof(state.sectorMs));
+    distanceMm = carryMm;
+    sectorStartMs = 0;
+
+    // Whatever the lap already covered past the line counts as time 0
+    currentPoints = 0;
+    while (currentPoints < LAP_REF_POINTS && currentPoints * STEP_MM <= carryMm) {
+        current[currentPoints++] = 0;
+    }
+}
+
+void LapTimer::finishLap(uint32_t atUs, uint32_t carryMm) {
+    uint32_t lapMs = (atUs - state.startUs) / 1000;
+
+    // Last sector runs to the line, sector bests only count from laps that passed every split
+    if (state.sector == state.sectors - 1) {
+        state.sectorMs[state.sector] = lapMs - sectorStartMs;
+        for (int i = 0; i < state.sectors; i++) {
+            if (state.bestSectorMs[i] == 0 || state.sectorMs[i] < state.bestSectorMs[i]) {
+                state.bestSectorMs[i] = state.sectorMs[i];
+            }
+        }
+    }
+
+    state.lap++;
+    state.lastLapMs = lapMs;
+    if (state.bestLapMs == 0 || lapMs < state.bestLapMs) {
+        state.bestLapMs = lapMs;
+        uint32_t* swap = best;
+        best = current;
+        current = swap;
+        bestPoints = currentPoints;
+    }
+    startLap(atUs, carryMm);
+}
+
+void LapTimer::onChannel(int channel, const ChannelValue& value, uint8_t decimals) {
+    if (channel != speedChannel) return;
+
+    seqlock.beginWrite();
+    if (resetPending.exchange(false)) {
+        clear();
+    }
+
+    // Distance since the previous speed frame, trapezoid: (v0 + v1) / 2 * dt.
+    // km/h * 10^decimals * us / (3600 * 10^decimals) = mm
+    uint32_t nowUs = value.timestampUs;
+    int32_t speed = value.value > 0 ? value.value : 0;
+    uint32_t prevUs = lastUs;
+    uint32_t prevMm = distanceMm;
+    uint32_t prevLapMs = state.lapMs;
+    if (haveSpeed && nowUs - prevUs <= LAP_MAX_GAP_US) {
+        uint64_t divisor = 7200ull * SCALING_POW10[decimals < SCALING_MAX_DECIMALS ? decimals : SCALING_MAX_DECIMALS];
+        remainder += (uint64_t)(lastSpeed + speed) * (nowUs - prevUs);
+        distanceMm += (uint32_t)(remainder / divisor);
+        remainder %= divisor;
+    }
+    haveSpeed = true;
+    lastUs = nowUs;
+    lastSpeed = speed;
+
+    if (state.running) {
+        state.lapMs = (nowUs - state.startUs) / 1000;
+        uint32_t spanMm = distanceMm - prevMm;
+
+        // Reference points passed since the last frame, timed linearly in between.
+        // One per frame at normal speeds and frame rates, a handful after a gap.
+        while (currentPoints < LAP_REF_POINTS && currentPoints * STEP_MM <= distanceMm) {
+            uint32_t pointMm = currentPoints * STEP_MM;
+            current[currentPoints++] = spanMm ? prevLapMs + (uint32_t)((uint64_t)(state.lapMs - prevLapMs) * (pointMm - prevMm) / spanMm)
+                                              : state.lapMs;
+        }
+
+        if (state.sector + 1 < state.sectors && distanceMm >= sectorEndMm[state.sector]) {
+            state.sectorMs[state.sector] = state.lapMs - sectorStartMs;
+            sectorStartMs = state.lapMs;
+            state.sector++;
+        }
+
+        if (trackLengthMm && distanceMm >= trackLengthMm) {
+            // Crossed the line somewhere since the last frame
+            uint32_t overMm = distanceMm - trackLengthMm;
+            uint32_t crossUs = nowUs - (spanMm ? (uint32_t)((uint64_t)(nowUs - prevUs) * overMm / spanMm) : 0);
+            finishLap(crossUs, overMm);
+            state.lapMs = (nowUs - state.startUs) / 1000;
+        }
+
+        // Predictive delta: this lap vs the best one at the same distance
+        uint32_t i = distanceMm / STEP_MM;
+        state.deltaValid = i + 1 < bestPoints;
+        if (state.deltaValid) {
+            uint32_t reference = best[i] + (uint32_t)((uint64_t)(best[i + 1] - best[i]) * (distanceMm - i * STEP_MM) / STEP_MM);
+            state.deltaMs = (int32_t)(state.lapMs - reference);
+        }
+    }
+
+    if (triggerPending.exchange(false)) {
+        // The button is the line: the lap ends when it was pressed, not at this frame
+        uint32_t atUs = triggerUs;
+        if ((int32_t)(nowUs - atUs) < 0 || nowUs - atUs > LAP_MAX_GAP_US) atUs = nowUs;
+        if (state.running) {
+            finishLap(atUs, 0);
+        }
+        else {
+            startLap(atUs, 0);
+        }
+        state.lapMs = (nowUs - state.startUs) / 1000;
+    }
+
+    state.distanceM = distanceMm / 1000;
+    state.version++;
+    seqlock.endWrite();
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "Hal.h"
+#include "CANDataManager.h"
+#include "SeqLock.h"
+#include <atomic>
+
+#ifndef LAP_REF_STEP_M
+#define LAP_REF_STEP_M 5                // Reference lap resolution
+#endif
+#ifndef LAP_REF_POINTS
+#define LAP_REF_POINTS 1024             // * LAP_REF_STEP_M = longest lap with a delta (5.1 km)
+#endif
+#define LAP_MAX_SECTORS 4
+#define LAP_MAX_GAP_US 500000           // Speed gaps longer than this aren't integrated
+
+// Lap and sector times from the vehicle speed channel. Distance is the integral of speed
+// (trapezoid between consecutive frames), a lap ends at the start/finish button or, with a
+// track length set, every trackLength meters after the first button press. While a lap runs
+// the time at every LAP_REF_STEP_M is recorded. The fastest lap keeps that array as the
+// reference, and the live delta is the lap time now minus the reference time interpolated at the
+// same distance. All of it is O(1) per speed frame: it runs as a ChannelListener inside the
+// decode, so at the full CAN rate.
+//
+// Everything is written from the decoding task. Readers use status(), a seqlock copy like
+// CANDataManager::snapshot(). trigger() and reset() are only flags, safe from any core.
+
+struct LapStatus {
+    bool running;                       // Started by the first trigger
+    uint16_t lap;                       // Laps completed
+    uint32_t startUs;                   // halMicros() clock, when the running lap began
+    uint32_t lapMs;                     // Running lap at the last speed frame
+    uint32_t distanceM;                 // Into the running lap
+    uint32_t lastLapMs;                 // 0 = none yet
+    uint32_t bestLapMs;
+    int32_t deltaMs;                    // Against the best lap at the same distance, + = slower
+    bool deltaValid;                    // There is a best lap and it reached this far
+    uint8_t sector;                     // Running sector
+    uint8_t sectors;
+    uint32_t sectorMs[LAP_MAX_SECTORS]; // Completed sectors of the running lap
+    uint32_t bestSectorMs[LAP_MAX_SECTORS];
+    uint32_t version;                   // Changes with every update
+
+    uint32_t currentLapMs(uint32_t nowUs) const { return running ? (nowUs - startUs) / 1000 : 0; }   // Between frames too
+    int32_t predictedLapMs() const { return deltaValid ? (int32_t)bestLapMs + deltaMs : 0; }
+};
+
+class LapTimer : public ChannelListener {
+public:
+    void begin(int speedChannel);       // Before the listener is registered
+    void setTrackLength(uint32_t meters);   // 0 = laps only end at the button
+    bool setSectors(const uint32_t* endsM, int count);   // Sector end distances within a lap, ascending, the last sector runs to the line
+    void trigger() { triggerUs = halMicros(); triggerPending = true; }   // Start/finish button
+    void reset() { resetPending = true; }   // Forget all laps and the reference
+    void status(LapStatus& out) const;
+    void onChannel(int channel, const ChannelValue& value, uint8_t decimals) override;
+
+private:
+    void clear();
+    void startLap(uint32_t atUs, uint32_t carryMm);
+    void finishLap(uint32_t atUs, uint32_t carryMm);
+
+    int speedChannel = -1;
+    uint32_t trackLengthMm = 0;
+    uint32_t sectorEndMm[LAP_MAX_SECTORS];
+    uint8_t sectorCount = 0;
+
+    // Integration
+    bool haveSpeed = false;
+    uint32_t lastUs = 0;
+    int32_t lastSpeed = 0;              // km/h * 10^decimals
+    uint64_t remainder = 0;             // Distance below 1 mm, carried so nothing drifts
+    uint32_t distanceMm = 0;            // Into the running lap
+    uint32_t sectorStartMs = 0;
+
+    // Reference laps, swapped (not copied) when a lap becomes the best
+    uint32_t refA[LAP_REF_POINTS];
+    uint32_t refB[LAP_REF_POINTS];
+    uint32_t* best = refA;
+    uint32_t* current = refB;           // Lap ms at each LAP_REF_STEP_M of the running lap
+    uint16_t bestPoints = 0;
+    uint16_t currentPoints = 0;
+
+    LapStatus state = {};
+    SeqLock seqlock;                    // Held while state is being written
+    std::atomic<bool> triggerPending{false};
+    std::atomic<bool> resetPending{false};
+    volatile uint32_t triggerUs = 0;
+};
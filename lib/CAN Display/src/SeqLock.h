@@ -0,0 +1,33 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+// One writer (the ingest task), readers that never block it: the writer brackets every change
+// with beginWrite()/endWrite(), a reader copies the state out inside read() and copies again if
+// a write started or finished meanwhile. The count is odd while a write is in progress.
+class SeqLock {
+public:
+    void beginWrite() {
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    void endWrite() { count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Runs copy() until it ran without a write in between, returns the count it read at
+    template <typename Copy>
+    uint32_t read(Copy copy) const {
+        uint32_t before;
+        do {
+            before = count.load(std::memory_order_acquire);
+            if (before & 1) {           // Writer mid-batch, a few us at most
+                continue;
+            }
+            copy();
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((before & 1) || count.load(std::memory_order_relaxed) != before);
+        return before;
+    }
+
+private:
+    std::atomic<uint32_t> count{0};
+};
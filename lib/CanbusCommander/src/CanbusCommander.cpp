@@ -1,5 +1,8 @@
 #include "CanbusCommander.h"
 
+#ifdef ARDUINO
+#include <Arduino.h>
+
 void initPins() {
     pinMode(SCREEN_ON, OUTPUT);
     pinMode(UP_SW, INPUT);
@@ -11,4 +14,5 @@ void initPins() {
 
     pinMode(CAN_TXD, INPUT);
     pinMode(CAN_RXD, OUTPUT);
-}
\ No newline at end of file
+}
+#endif
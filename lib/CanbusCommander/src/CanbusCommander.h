@@ -1,7 +1,7 @@
 #ifndef MY_BOARD_H
 #define MY_BOARD_H
 
-#include <Arduino.h>
+#include <stdint.h>
 
 // Example pin assignments
 const uint8_t SCREEN_ON = 8;
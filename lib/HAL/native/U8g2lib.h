@@ -0,0 +1,51 @@
+#pragma once
+// Host stand-in for the Arduino U8g2lib.h: the same U8G2 method names, forwarded
+// to the portable u8g2 C core (clib/) that [env:native] compiles. The display
+// callbacks do nothing, finished frames are read back through getBufferPtr().
+#include "clib/u8g2.h"
+
+class U8G2 {
+public:
+    u8g2_t* getU8g2() { return &u8g2; }
+
+    void begin() { u8g2_InitDisplay(&u8g2); u8g2_SetPowerSave(&u8g2, 0); }
+    void clearBuffer() { u8g2_ClearBuffer(&u8g2); }
+    void sendBuffer() { u8g2_SendBuffer(&u8g2); }
+    void updateDisplayArea(uint8_t tx, uint8_t ty, uint8_t tw, uint8_t th) { u8g2_UpdateDisplayArea(&u8g2, tx, ty, tw, th); }
+    uint8_t* getBufferPtr() { return u8g2_GetBufferPtr(&u8g2); }
+    uint8_t getBufferTileWidth() { return u8g2_GetBufferTileWidth(&u8g2); }
+    uint8_t getBufferTileHeight() { return u8g2_GetBufferTileHeight(&u8g2); }
+    u8g2_uint_t getDisplayWidth() { return u8g2_GetDisplayWidth(&u8g2); }
+    u8g2_uint_t getDisplayHeight() { return u8g2_GetDisplayHeight(&u8g2); }
+
+    void setFont(const uint8_t* font) { u8g2_SetFont(&u8g2, font); }
+    void setFontRefHeightExtendedText() { u8g2_SetFontRefHeightExtendedText(&u8g2); }
+    void setFontPosTop() { u8g2_SetFontPosTop(&u8g2); }
+    void setFontDirection(uint8_t dir) { u8g2_SetFontDirection(&u8g2, dir); }
+    void setDrawColor(uint8_t color) { u8g2_SetDrawColor(&u8g2, color); }
+    int8_t getMaxCharHeight() { return u8g2_GetMaxCharHeight(&u8g2); }
+    u8g2_uint_t getStrWidth(const char* s) { return u8g2_GetStrWidth(&u8g2, s); }
+    u8g2_uint_t drawStr(u8g2_uint_t x, u8g2_uint_t y, const char* s) { return u8g2_DrawStr(&u8g2, x, y, s); }
+
+    void drawPixel(u8g2_uint_t x, u8g2_uint_t y) { u8g2_DrawPixel(&u8g2, x, y); }
+    void drawHLine(u8g2_uint_t x, u8g2_uint_t y, u8g2_uint_t w) { u8g2_DrawHLine(&u8g2, x, y, w); }
+    void drawVLine(u8g2_uint_t x, u8g2_uint_t y, u8g2_uint_t h) { u8g2_DrawVLine(&u8g2, x, y, h); }
+    void drawLine(u8g2_uint_t x1, u8g2_uint_t y1, u8g2_uint_t x2, u8g2_uint_t y2) { u8g2_DrawLine(&u8g2, x1, y1, x2, y2); }
+    void drawBox(u8g2_uint_t x, u8g2_uint_t y, u8g2_uint_t w, u8g2_uint_t h) { u8g2_DrawBox(&u8g2, x, y, w, h); }
+    void drawFrame(u8g2_uint_t x, u8g2_uint_t y, u8g2_uint_t w, u8g2_uint_t h) { u8g2_DrawFrame(&u8g2, x, y, w, h); }
+    void drawXBMP(u8g2_uint_t x, u8g2_uint_t y, u8g2_uint_t w, u8g2_uint_t h, const uint8_t* bitmap) { u8g2_DrawXBMP(&u8g2, x, y, w, h, bitmap); }
+
+protected:
+    static uint8_t nullCallback(u8x8_t*, uint8_t, uint8_t, void*) { return 1; }
+    u8g2_t u8g2;
+};
+
+class U8G2_KS0108_128X64_F : public U8G2 {
+public:
+    // Same signature as the Arduino class, the pins mean nothing on the host
+    U8G2_KS0108_128X64_F(const u8g2_cb_t* rotation, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3,
+                         uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7, uint8_t enable, uint8_t dc,
+                         uint8_t cs0, uint8_t cs1, uint8_t cs2, uint8_t reset = U8X8_PIN_NONE) {
+        u8g2_Setup_ks0108_128x64_f(&u8g2, rotation, nullCallback, nullCallback);
+    }
+};
@@ -0,0 +1,12 @@
+#pragma once
+#include <stdint.h>
+
+// Raw frame as handed from the ingest task to CANDataManager.
+// Kept independent of twai_message_t so any frame source can fill it.
+struct CANFrame {
+    uint32_t identifier;
+    uint32_t timestampUs;               // micros() when the frame was pulled off the bus
+    uint8_t extd;                       // 1 = 29 bit extended ID
+    uint8_t dlc;
+    uint8_t data[8];
+};
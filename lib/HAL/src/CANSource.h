@@ -0,0 +1,52 @@
+#pragma once
+#include "CANFrame.h"
+
+// Frames lost before receive() could see them
+struct CANRxLoss {
+    uint32_t missed;                    // RX queue was full
+    uint32_t overrun;                   // Controller FIFO overran before the ISR emptied it
+};
+
+// Anything CANDataManager can pull frames from: the TWAI driver on target,
+// a recorded trace or a test queue on the host.
+class CANSource {
+public:
+    virtual ~CANSource() {}
+    virtual bool receive(CANFrame& frame, uint32_t timeoutMs) = 0;  // false on timeout/no frame
+    virtual bool rxLoss(CANRxLoss& out) { out = CANRxLoss{}; return false; }   // Since the driver started, false if the source can't tell
+};
+
+#ifdef ARDUINO
+#include "driver/twai.h"
+
+// A log block erase turns the flash cache off, which stops the ingest task (it runs from
+// flash) for up to the erase time. The TWAI ISR is in IRAM (CONFIG_TWAI_ISR_IN_IRAM) and keeps
+// filling the RX queue meanwhile, so the queue has to hold a full bus for the worst erase.
+#define TWAI_BUS_MAX_FPS 4500           // 500 kbit/s, back to back 8 byte standard frames
+#define TWAI_ERASE_MAX_MS 400           // 4 KB sector erase, flash datasheet worst case (typically 45)
+#define TWAI_RX_QUEUE_LEN (TWAI_BUS_MAX_FPS * TWAI_ERASE_MAX_MS / 1000)   // 1800 frames, ~36 KB of internal RAM
+#define TWAI_TX_QUEUE_LEN 10
+
+// ESP32 TWAI driver, installed and started elsewhere (canSetup())
+class TwaiCANSource : public CANSource {
+public:
+    bool receive(CANFrame& frame, uint32_t timeoutMs) override;
+    bool rxLoss(CANRxLoss& out) override;   // twai_get_status_info()'s rx_missed_count/rx_overrun_count
+
+    // What canSetup() installs the driver with: the queue sizes above, ISR in IRAM
+    static twai_general_config_t generalConfig(uint8_t txPin, uint8_t rxPin, twai_mode_t mode = TWAI_MODE_NORMAL);
+};
+#else
+// Host stand-in: frames pushed by test/bench code, thread safe
+class QueueCANSource : public CANSource {
+public:
+    QueueCANSource();
+    ~QueueCANSource();
+    void push(const CANFrame& frame);
+    bool receive(CANFrame& frame, uint32_t timeoutMs) override;
+
+private:
+    struct Impl;
+    Impl* impl;
+};
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+
+// Where a finished frame goes. buffer is u8g2's full buffer: tileHeight pages
+// of tileWidth*8 bytes, one byte = 8 vertical pixels (KS0108 layout).
+class FramebufferSink {
+public:
+    virtual ~FramebufferSink() {}
+    virtual void present(const uint8_t* buffer, uint8_t tileWidth, uint8_t tileHeight) = 0;
+    virtual uint32_t lastTransferBytes() const { return 0; }     // What the last present() put on the bus, 0 = not tracked
+};
+
+#ifndef ARDUINO
+// Host stand-in: keeps a copy of the last frame
+class MemorySink : public FramebufferSink {
+public:
+    void present(const uint8_t* buffer, uint8_t tileWidth, uint8_t tileHeight) override;
+    bool pixel(int x, int y) const;
+    void print() const;                 // ASCII art to stdout
+
+    uint32_t frames = 0;
+    uint8_t width = 0, height = 0;
+    uint8_t frame[1024];                // 128x64 max
+};
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Everything the display/decode code needs from the platform.
+// ARDUINO builds map straight onto the Arduino/ESP-IDF calls, the native
+// (Linux host) build gets stand-ins from HalNative.cpp.
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+inline uint32_t halMillis() { return millis(); }
+inline uint32_t halMicros() { return micros(); }
+inline void halDelay(uint32_t ms) { delay(ms); }
+inline bool halReadButton(uint8_t pin) { return digitalRead(pin); }
+inline void halAttachButtonInterrupt(uint8_t pin, void (*isr)(void*), void* arg) { attachInterruptArg(pin, isr, arg, CHANGE); }
+inline void halConfigureOutput(uint8_t pin) { pinMode(pin, OUTPUT); digitalWrite(pin, LOW); }
+inline void halWriteOutput(uint8_t pin, bool on) { digitalWrite(pin, on ? HIGH : LOW); }
+void halLog(const char* fmt, ...);                  // printf to Serial
+
+#define HAL_ISR_ATTR IRAM_ATTR                     // Interrupt handlers must not live in flash
+
+#else
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+
+uint32_t halMillis();
+uint32_t halMicros();
+void halDelay(uint32_t ms);
+bool halReadButton(uint8_t pin);
+void halSetButton(uint8_t pin, bool pressed);     // Host only, simulated button state
+void halAttachButtonInterrupt(uint8_t pin, void (*isr)(void*), void* arg);   // isr runs inside halSetButton() on a change
+void halConfigureOutput(uint8_t pin);
+void halWriteOutput(uint8_t pin, bool on);
+bool halReadOutput(uint8_t pin);                   // Host only, what halWriteOutput() last set
+void halLog(const char* fmt, ...);                  // printf to stdout
+long random(long min, long max);                   // Arduino's, used by the cup animation
+
+#define HAL_ISR_ATTR
+#endif
+
+// halDelay() that halWake() from another task cuts short, for the UI loop's idle sleep.
+// One waiter at a time, a wake with nobody waiting makes the next wait return at once.
+void halWaitForWake(uint32_t ms);
+void halWake();
+
+// A task (std::thread on the host) that halJoinTask() waits for. The task just returns when
+// it's done, it must not delete itself: the wrapper signals the joiner first, so nobody ever
+// looks at the handle of a deleted FreeRTOS task. nullptr if it couldn't be created.
+void* halStartTask(void (*task)(void*), const char* name, void* arg, int priority, int core, uint32_t stackBytes = 4096);
+void halJoinTask(void* handle);         // Waits for the task to return, frees the handle
@@ -0,0 +1,122 @@
+#ifdef ARDUINO
+#include "Hal.h"
+#include "CANSource.h"
+#include "LogStorage.h"
+#include "driver/twai.h"
+#include <stdarg.h>
+
+void halLog(const char* fmt, ...) {
+    char buffer[160];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+    Serial.print(buffer);
+}
+
+static volatile TaskHandle_t wakeTask = nullptr;
+
+void halWaitForWake(uint32_t ms) {
+    wakeTask = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms));
+}
+
+void halWake() {
+    TaskHandle_t task = wakeTask;
+    if (task) xTaskNotifyGive(task);
+}
+
+struct HalTask {
+    void (*task)(void*);
+    void* arg;
+    SemaphoreHandle_t done;             // Given as the last thing the task does
+};
+
+static void halTaskMain(void* arg) {
+    HalTask* t = static_cast<HalTask*>(arg);
+    t->task(t->arg);
+    xSemaphoreGive(t->done);            // t may be freed from here on
+    vTaskDelete(nullptr);
+}
+
+void* halStartTask(void (*task)(void*), const char* name, void* arg, int priority, int core, uint32_t stackBytes) {
+    HalTask* t = new HalTask{task, arg, xSemaphoreCreateBinary()};
+    if (t->done == nullptr) {
+        delete t;
+        return nullptr;
+    }
+    if (xTaskCreatePinnedToCore(halTaskMain, name, stackBytes, t, priority, nullptr, core) != pdPASS) {
+        vSemaphoreDelete(t->done);
+        delete t;
+        return nullptr;
+    }
+    return t;
+}
+
+void halJoinTask(void* handle) {
+    HalTask* t = static_cast<HalTask*>(handle);
+    xSemaphoreTake(t->done, portMAX_DELAY);
+    vSemaphoreDelete(t->done);
+    delete t;
+}
+
+bool TwaiCANSource::receive(CANFrame& frame, uint32_t timeoutMs) {
+    twai_message_t message;
+    esp_err_t err = twai_receive(&message, pdMS_TO_TICKS(timeoutMs));
+
+    if (err != ESP_OK) {
+        if (err != ESP_ERR_TIMEOUT && timeoutMs > 0) {
+            // Driver not installed/running (canSetup() restarting it), back off instead of spinning
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        return false;
+    }
+
+    frame.identifier = message.identifier;
+    frame.timestampUs = micros();
+    frame.extd = message.extd;
+    frame.dlc = message.data_length_code > 8 ? 8 : message.data_length_code;
+    memcpy(frame.data, message.data, sizeof(frame.data));
+    return true;
+}
+
+bool TwaiCANSource::rxLoss(CANRxLoss& out) {
+    twai_status_info_t status;
+    if (twai_get_status_info(&status) != ESP_OK) {
+        out = CANRxLoss{};
+        return false;
+    }
+    out.missed = status.rx_missed_count;
+    out.overrun = status.rx_overrun_count;
+    return true;
+}
+
+twai_general_config_t TwaiCANSource::generalConfig(uint8_t txPin, uint8_t rxPin, twai_mode_t mode) {
+    twai_general_config_t config = TWAI_GENERAL_CONFIG_DEFAULT((gpio_num_t)txPin, (gpio_num_t)rxPin, mode);
+    config.rx_queue_len = TWAI_RX_QUEUE_LEN;
+    config.tx_queue_len = TWAI_TX_QUEUE_LEN;
+#ifdef CONFIG_TWAI_ISR_IN_IRAM
+    config.intr_flags |= ESP_INTR_FLAG_IRAM;   // Keeps running while a log block erase has the cache off
+#else
+#warning "CONFIG_TWAI_ISR_IN_IRAM is off, frames are lost while the data logger erases a block (see platformio.ini)"
+#endif
+    return config;
+}
+
+bool PartitionLogStorage::begin() {
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)LOG_PARTITION_SUBTYPE,
+                                         LOG_PARTITION_LABEL);
+    return partition != nullptr;
+}
+
+bool PartitionLogStorage::writeBlock(uint32_t offset, const uint8_t* data) {
+    if (partition == nullptr || offset % blockSize() != 0 || offset + blockSize() > capacity()) return false;
+    if (esp_partition_erase_range(partition, offset, blockSize()) != ESP_OK) return false;
+    return esp_partition_write(partition, offset, data, blockSize()) == ESP_OK;
+}
+
+bool PartitionLogStorage::read(uint32_t offset, void* data, size_t len) {
+    if (partition == nullptr || offset + len > capacity()) return false;
+    return esp_partition_read(partition, offset, data, len) == ESP_OK;
+}
+#endif
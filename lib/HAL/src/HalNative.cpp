@@ -0,0 +1,209 @@
+#ifndef ARDUINO
+#include "Hal.h"
+#include "CANSource.h"
+#include "KeyValueStore.h"
+#include "FramebufferSink.h"
+#include "LogStorage.h"
+
+#include <stdarg.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***************** CLOCK / GPIO *********************/
+static const std::chrono::steady_clock::time_point bootTime = std::chrono::steady_clock::now();
+static bool buttonState[64];
+static bool outputState[64];
+static void (*buttonIsr[64])(void*);
+static void* buttonIsrArg[64];
+
+uint32_t halMillis() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - bootTime).count();
+}
+
+uint32_t halMicros() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - bootTime).count();
+}
+
+void halDelay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+bool halReadButton(uint8_t pin) {
+    return pin < 64 && buttonState[pin];
+}
+
+void halSetButton(uint8_t pin, bool pressed) {
+    if (pin >= 64 || buttonState[pin] == pressed) return;
+    buttonState[pin] = pressed;
+    if (buttonIsr[pin]) buttonIsr[pin](buttonIsrArg[pin]);     // Same as the CHANGE interrupt on the target
+}
+
+void halAttachButtonInterrupt(uint8_t pin, void (*isr)(void*), void* arg) {
+    if (pin >= 64) return;
+    buttonIsr[pin] = isr;
+    buttonIsrArg[pin] = arg;
+}
+
+void halConfigureOutput(uint8_t pin) {
+    if (pin < 64) outputState[pin] = false;
+}
+
+void halWriteOutput(uint8_t pin, bool on) {
+    if (pin < 64) outputState[pin] = on;
+}
+
+bool halReadOutput(uint8_t pin) {
+    return pin < 64 && outputState[pin];
+}
+
+static std::mutex wakeMutex;
+static std::condition_variable wakeSignal;
+static bool wakePending = false;
+
+void halWaitForWake(uint32_t ms) {
+    std::unique_lock<std::mutex> guard(wakeMutex);
+    wakeSignal.wait_for(guard, std::chrono::milliseconds(ms), [] { return wakePending; });
+    wakePending = false;
+}
+
+void* halStartTask(void (*task)(void*), const char* name, void* arg, int priority, int core, uint32_t stackBytes) {
+    return new std::thread(task, arg);
+}
+
+void halJoinTask(void* handle) {
+    std::thread* thread = static_cast<std::thread*>(handle);
+    thread->join();
+    delete thread;
+}
+
+void halWake() {
+    {
+        std::lock_guard<std::mutex> guard(wakeMutex);
+        wakePending = true;
+    }
+    wakeSignal.notify_one();
+}
+
+void halLog(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+long random(long min, long max) {
+    return max > min ? min + rand() % (max - min) : min;
+}
+
+/***************** CAN *********************/
+struct QueueCANSource::Impl {
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<CANFrame> frames;
+};
+
+QueueCANSource::QueueCANSource() : impl(new Impl) {}
+QueueCANSource::~QueueCANSource() { delete impl; }
+
+void QueueCANSource::push(const CANFrame& frame) {
+    {
+        std::lock_guard<std::mutex> guard(impl->lock);
+        impl->frames.push_back(frame);
+    }
+    impl->ready.notify_one();
+}
+
+bool QueueCANSource::receive(CANFrame& frame, uint32_t timeoutMs) {
+    std::unique_lock<std::mutex> guard(impl->lock);
+    if (!impl->ready.wait_for(guard, std::chrono::milliseconds(timeoutMs), [this] { return !impl->frames.empty(); })) {
+        return false;
+    }
+    frame = impl->frames.front();
+    impl->frames.pop_front();
+    return true;
+}
+
+/***************** STORAGE *********************/
+struct MemoryStore::Impl {
+    std::map<std::string, std::vector<uint8_t>> values;
+    std::string ns;
+};
+
+MemoryStore::MemoryStore() : impl(new Impl) {}
+MemoryStore::~MemoryStore() { delete impl; }
+
+bool MemoryStore::begin(const char* ns, bool readOnly) {
+    impl->ns = std::string(ns) + "/";
+    return true;
+}
+
+void MemoryStore::end() {}
+
+size_t MemoryStore::putBytes(const char* key, const void* value, size_t len) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    impl->values[impl->ns + key].assign(bytes, bytes + len);
+    return len;
+}
+
+size_t MemoryStore::getBytes(const char* key, void* buf, size_t maxLen) {
+    auto it = impl->values.find(impl->ns + key);
+    if (it == impl->values.end() || it->second.size() > maxLen) return 0;
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+/***************** DATA LOG *********************/
+MemoryLogStorage::MemoryLogStorage(uint32_t capacity, uint32_t blockSize)
+    : bytes(new uint8_t[capacity - capacity % blockSize]), size(capacity - capacity % blockSize), block(blockSize) {
+    memset(bytes, 0xFF, size);
+}
+
+MemoryLogStorage::~MemoryLogStorage() { delete[] bytes; }
+
+bool MemoryLogStorage::writeBlock(uint32_t offset, const uint8_t* data) {
+    if (offset % block != 0 || offset + block > size) return false;
+    memcpy(bytes + offset, data, block);
+    return true;
+}
+
+bool MemoryLogStorage::read(uint32_t offset, void* data, size_t len) {
+    if (offset + len > size) return false;
+    memcpy(data, bytes + offset, len);
+    return true;
+}
+
+bool MemoryLogStorage::save(const char* path) const {
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) return false;
+    bool ok = fwrite(bytes, 1, size, file) == size;
+    return fclose(file) == 0 && ok;
+}
+
+/***************** DISPLAY *********************/
+void MemorySink::present(const uint8_t* buffer, uint8_t tileWidth, uint8_t tileHeight) {
+    size_t bytes = (size_t)tileWidth * 8 * tileHeight;
+    if (bytes > sizeof(frame)) bytes = sizeof(frame);
+    memcpy(frame, buffer, bytes);
+    width = tileWidth * 8;
+    height = tileHeight * 8;
+    frames++;
+}
+
+bool MemorySink::pixel(int x, int y) const {
+    if (x < 0 || y < 0 || x >= width || y >= height) return false;
+    return frame[(y / 8) * width + x] & (1 << (y % 8));
+}
+
+void MemorySink::print() const {
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) putchar(pixel(x, y) ? '#' : '.');
+        putchar('\n');
+    }
+}
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#include <stddef.h>
+
+// Subset of ESP32 Preferences the settings code uses
+class KeyValueStore {
+public:
+    virtual ~KeyValueStore() {}
+    virtual bool begin(const char* ns, bool readOnly) = 0;
+    virtual void end() = 0;
+    virtual size_t putBytes(const char* key, const void* value, size_t len) = 0;
+    virtual size_t getBytes(const char* key, void* buf, size_t maxLen) = 0;
+};
+
+#ifdef ARDUINO
+#include <Preferences.h>
+
+class PreferencesStore : public KeyValueStore {
+public:
+    bool begin(const char* ns, bool readOnly) override { return prefs.begin(ns, readOnly); }
+    void end() override { prefs.end(); }
+    size_t putBytes(const char* key, const void* value, size_t len) override { return prefs.putBytes(key, value, len); }
+    size_t getBytes(const char* key, void* buf, size_t maxLen) override { return prefs.getBytes(key, buf, maxLen); }
+
+private:
+    Preferences prefs;
+};
+#else
+// Host stand-in, lives for the process only
+class MemoryStore : public KeyValueStore {
+public:
+    MemoryStore();
+    ~MemoryStore();
+    bool begin(const char* ns, bool readOnly) override;
+    void end() override;
+    size_t putBytes(const char* key, const void* value, size_t len) override;
+    size_t getBytes(const char* key, void* buf, size_t maxLen) override;
+
+private:
+    struct Impl;
+    Impl* impl;
+};
+#endif
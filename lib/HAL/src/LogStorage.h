@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Raw flash area for the data logger. Written one whole erase block at a time at
+// block-aligned offsets, so every write is one erase + one program and nothing else
+// on the chip (NVS, the app) is touched.
+class LogStorage {
+public:
+    virtual ~LogStorage() {}
+    virtual bool begin() = 0;                           // false if the area doesn't exist
+    virtual uint32_t capacity() const = 0;              // Bytes, a multiple of blockSize()
+    virtual uint32_t blockSize() const = 0;             // Erase unit
+    virtual bool writeBlock(uint32_t offset, const uint8_t* data) = 0;   // Erase + program blockSize() bytes
+    virtual bool read(uint32_t offset, void* data, size_t len) = 0;
+};
+
+#ifdef ARDUINO
+#include <esp_partition.h>
+
+#define LOG_PARTITION_LABEL "datalog"   // partitions.csv
+#define LOG_PARTITION_SUBTYPE 0x40      // Custom data subtype
+
+// The "datalog" partition, straight through esp_partition (no filesystem in the way)
+class PartitionLogStorage : public LogStorage {
+public:
+    bool begin() override;
+    uint32_t capacity() const override { return partition ? partition->size - partition->size % blockSize() : 0; }
+    uint32_t blockSize() const override { return SPI_FLASH_SEC_SIZE; }
+    bool writeBlock(uint32_t offset, const uint8_t* data) override;
+    bool read(uint32_t offset, void* data, size_t len) override;
+
+private:
+    const esp_partition_t* partition = nullptr;
+};
+#else
+// Host stand-in: the "partition" is RAM (erased = 0xFF), save() dumps it to a file
+class MemoryLogStorage : public LogStorage {
+public:
+    explicit MemoryLogStorage(uint32_t capacity = 0x270000, uint32_t blockSize = 4096);
+    ~MemoryLogStorage();
+    bool begin() override { return true; }
+    uint32_t capacity() const override { return size; }
+    uint32_t blockSize() const override { return block; }
+    bool writeBlock(uint32_t offset, const uint8_t* data) override;
+    bool read(uint32_t offset, void* data, size_t len) override;
+    bool save(const char* path) const;
+
+private:
+    uint8_t* bytes;
+    uint32_t size;
+    uint32_t block;
+};
+#endif
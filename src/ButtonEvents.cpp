@@ -0,0 +1,100 @@
+#include "ButtonEvents.h"
+#include "Hal.h"
+#include "CanbusCommander.h"
+
+static const uint8_t BUTTON_PINS[BUTTON_COUNT] = {UP_SW, DOWN_SW, LEFT_SW, RIGHT_SW, NEXT_SW, PREV_SW};
+
+ButtonEvents::ButtonEvents() {
+    for (int i = 0; i < BUTTON_COUNT; i++) {
+        Button& b = buttons[i];
+        b.pin = BUTTON_PINS[i];
+        b.down = false;
+        b.longSent = false;
+        b.downMs = 0;
+        b.nextRepeatMs = 0;
+        b.lastEdgeMs = 0;
+        b.sawPress = false;
+    }
+}
+
+void ButtonEvents::begin() {
+    for (Button& b : buttons) {
+        halAttachButtonInterrupt(b.pin, onEdge, &b);
+    }
+}
+
+void HAL_ISR_ATTR ButtonEvents::onEdge(void* arg) {
+    Button* b = static_cast<Button*>(arg);
+    b->lastEdgeMs = halMillis();
+    if (halReadButton(b->pin)) b->sawPress = true;
+}
+
+void ButtonEvents::push(uint8_t pin, ButtonAction action, uint32_t nowMs) {
+    if (count == BUTTON_QUEUE_SIZE) {   // Nobody is reading, keep the oldest
+        dropped++;
+        return;
+    }
+    queue[(head + count) % BUTTON_QUEUE_SIZE] = ButtonEvent{pin, action, nowMs};
+    count++;
+}
+
+bool ButtonEvents::next(ButtonEvent& event) {
+    if (count == 0) return false;
+    event = queue[head];
+    head = (head + 1) % BUTTON_QUEUE_SIZE;
+    count--;
+    return true;
+}
+
+void ButtonEvents::poll(uint32_t nowMs) {
+    for (Button& b : buttons) {
+        if (nowMs - b.lastEdgeMs < BUTTON_DEBOUNCE_MS) continue;     // Still bouncing, decide later
+
+        bool level = halReadButton(b.pin);
+        bool tapped = b.sawPress.exchange(false);
+        if (level != b.down) {
+            b.down = level;
+            if (level) {
+                b.downMs = nowMs;
+                b.longSent = false;
+                push(b.pin, BUTTON_PRESS, nowMs);
+            }
+            else {
+                push(b.pin, BUTTON_RELEASE, nowMs);
+            }
+        }
+        else if (tapped && !level) {
+            // Pressed and released again since the last poll
+            push(b.pin, BUTTON_PRESS, nowMs);
+            push(b.pin, BUTTON_RELEASE, nowMs);
+        }
+
+        if (!b.down) continue;
+        if (!b.longSent) {
+            if (nowMs - b.downMs >= BUTTON_LONG_PRESS_MS) {
+                b.longSent = true;
+                b.nextRepeatMs = nowMs + BUTTON_REPEAT_MS;
+                push(b.pin, BUTTON_LONG_PRESS, nowMs);
+            }
+        }
+        else if ((int32_t)(nowMs - b.nextRepeatMs) >= 0) {
+            b.nextRepeatMs += BUTTON_REPEAT_MS;
+            if ((int32_t)(nowMs - b.nextRepeatMs) >= 0) b.nextRepeatMs = nowMs + BUTTON_REPEAT_MS;   // Polls were late, don't burst
+            push(b.pin, BUTTON_REPEAT, nowMs);
+        }
+    }
+}
+
+bool ButtonEvents::isDown(uint8_t pin) const {
+    for (const Button& b : buttons) {
+        if (b.pin == pin) return b.down;
+    }
+    return false;
+}
+
+bool ButtonEvents::anyDown() const {
+    for (const Button& b : buttons) {
+        if (b.down) return true;
+    }
+    return false;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+#ifndef BUTTON_DEBOUNCE_MS
+#define BUTTON_DEBOUNCE_MS 20           // Level has to be stable this long after the last edge
+#endif
+#ifndef BUTTON_LONG_PRESS_MS
+#define BUTTON_LONG_PRESS_MS 600
+#endif
+#ifndef BUTTON_REPEAT_MS
+#define BUTTON_REPEAT_MS 150            // Auto-repeat period once a press went long
+#endif
+#define BUTTON_QUEUE_SIZE 16
+#define BUTTON_COUNT 6                  // UP_SW ... PREV_SW
+
+// Front panel buttons as a queue of events instead of getSW() spinning until release.
+// A CHANGE interrupt on each pin only timestamps edges (and latches presses), poll()
+// turns that into debounced press/release/long-press/repeat events from loop() context,
+// next() hands them out. Nothing here waits on a button.
+// Without begin() (host builds that never attach) poll() still works off the pin levels.
+
+enum ButtonAction : uint8_t {
+    BUTTON_PRESS,
+    BUTTON_RELEASE,
+    BUTTON_LONG_PRESS,                  // Held BUTTON_LONG_PRESS_MS, once per press
+    BUTTON_REPEAT                       // Every BUTTON_REPEAT_MS after the long press while still held
+};
+
+struct ButtonEvent {
+    uint8_t pin;                        // UP_SW, DOWN_SW, ... as in CanbusCommander.h
+    ButtonAction action;
+    uint32_t ms;                        // When poll() saw it
+};
+
+class ButtonEvents {
+public:
+    ButtonEvents();
+    void begin();                       // Attaches the interrupts, again after initPins()
+    void poll(uint32_t nowMs);          // Every loop() pass, at least every few 10 ms
+    bool next(ButtonEvent& event);      // Oldest queued event, false if there is none
+    bool isDown(uint8_t pin) const;     // Debounced state
+    bool anyDown() const;
+    uint32_t eventsDropped() const { return dropped; }
+
+private:
+    struct Button {
+        uint8_t pin;
+        bool down;                      // Debounced
+        bool longSent;
+        uint32_t downMs;
+        uint32_t nextRepeatMs;
+        volatile uint32_t lastEdgeMs;   // Written by the ISR
+        std::atomic<bool> sawPress;     // ISR saw the pin go active, catches taps between two polls
+    };
+
+    static void onEdge(void* arg);
+    void push(uint8_t pin, ButtonAction action, uint32_t nowMs);
+
+    Button buttons[BUTTON_COUNT];
+    ButtonEvent queue[BUTTON_QUEUE_SIZE];
+    uint8_t head = 0;
+    uint8_t count = 0;
+    uint32_t dropped = 0;
+};
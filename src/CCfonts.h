@@ -5,7 +5,7 @@
   BBX Build Mode: 0
 */
 #pragma once
-#include <Arduino.h>
+#include "Hal.h"
 #include <U8g2lib.h>
 //#include "ucg.h"
 
@@ -0,0 +1,57 @@
+#pragma once
+#include <string.h>
+#include <U8g2lib.h>
+#include "FramebufferSink.h"
+
+// Target sink: u8g2 already owns the KS0108 bus, this decides how much of its buffer to push.
+// Keeps a shadow of what the panel shows and only resends the pages that changed, per
+// controller half (cs0 = columns 0..63, cs1 = 64..127). u8g2 transfers whole 8 column
+// tiles, so each changed run is widened to tile edges.
+class KS0108Sink : public FramebufferSink {
+public:
+    explicit KS0108Sink(U8G2& display) : display(display) {}
+
+    void present(const uint8_t* buffer, uint8_t tileWidth, uint8_t tileHeight) override {
+        int rowBytes = tileWidth * 8;
+        if (!shadowValid || rowBytes * tileHeight > (int)sizeof(shadow)) {
+            display.sendBuffer();
+            lastBytes = rowBytes * tileHeight;
+            if (rowBytes * tileHeight <= (int)sizeof(shadow)) {
+                memcpy(shadow, buffer, rowBytes * tileHeight);
+                shadowValid = true;
+            }
+            return;
+        }
+
+        lastBytes = 0;
+        int halfBytes = rowBytes / 2;
+        for (int page = 0; page < tileHeight; page++) {
+            for (int half = 0; half < 2; half++) {
+                int start = page * rowBytes + half * halfBytes;
+                const uint8_t* now = buffer + start;
+                uint8_t* was = shadow + start;
+
+                int first = 0, last = halfBytes - 1;
+                while (first < halfBytes && now[first] == was[first]) first++;
+                if (first == halfBytes) continue;           // Half page unchanged
+                while (now[last] == was[last]) last--;
+
+                int firstTile = first / 8, lastTile = last / 8;
+                display.updateDisplayArea(half * (tileWidth / 2) + firstTile, page, lastTile - firstTile + 1, 1);
+                memcpy(was + firstTile * 8, now + firstTile * 8, (lastTile - firstTile + 1) * 8);
+                lastBytes += (lastTile - firstTile + 1) * 8;
+            }
+        }
+    }
+
+    uint32_t lastTransferBytes() const override { return lastBytes; }
+
+    // Panel contents unknown (power cycled, u8g2.begin() again): next frame goes out in full
+    void invalidate() { shadowValid = false; }
+
+private:
+    U8G2& display;
+    uint8_t shadow[1024];               // 128x64
+    bool shadowValid = false;
+    uint32_t lastBytes = 0;
+};
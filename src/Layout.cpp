@@ -0,0 +1,207 @@
+#include "Layout.h"
+#include "screens.h"
+#include "FixedFormat.h"
+#include <string.h>
+
+// Characters numbers and hex IDs are made of, the only ones cachedStrWidth() keeps widths for
+static const char GLYPH_CACHE_CHARS[] = " -.0123456789ABCDEFx";
+#define GLYPH_CACHE_SIZE (sizeof(GLYPH_CACHE_CHARS) - 1)
+
+struct GlyphWidths {
+    const uint8_t* font;
+    int8_t advance[GLYPH_CACHE_SIZE];   // -1 = not in the font
+    int8_t last[GLYPH_CACHE_SIZE];      // Width as the last glyph of a string: ink width + x offset
+};
+
+static GlyphWidths glyphCache[GLYPH_CACHE_FONTS];
+static uint8_t glyphCacheUsed = 0;
+
+static int glyphSlot(char c) {
+    if (c >= '0' && c <= '9') return 3 + c - '0';
+    if (c >= 'A' && c <= 'F') return 13 + c - 'A';
+    switch (c) {
+    case ' ': return 0;
+    case '-': return 1;
+    case '.': return 2;
+    case 'x': return 19;
+    default:  return -1;
+    }
+}
+
+static const GlyphWidths* glyphWidths(const uint8_t* font) {
+    for (int i = 0; i < glyphCacheUsed; i++) {
+        if (glyphCache[i].font == font) return &glyphCache[i];
+    }
+    if (glyphCacheUsed == GLYPH_CACHE_FONTS) return nullptr;
+
+    // Same numbers u8g2's string width uses: every glyph's advance, except that the last
+    // glyph counts its ink width plus x offset (unless it has no ink, like a space)
+    GlyphWidths& g = glyphCache[glyphCacheUsed++];
+    g.font = font;
+    u8g2_t* core = u8g2.getU8g2();
+    for (size_t i = 0; i < GLYPH_CACHE_SIZE; i++) {
+        core->font_decode.glyph_width = 0;
+        int8_t dx = u8g2_GetGlyphWidth(core, (uint8_t)GLYPH_CACHE_CHARS[i]);
+        int8_t ink = core->font_decode.glyph_width;
+        bool missing = dx == 0 && ink == 0;
+        g.advance[i] = missing ? -1 : dx;
+        g.last[i] = missing ? -1 : ink != 0 ? ink + core->glyph_x_offset : dx;
+    }
+    return &g;
+}
+
+int16_t cachedStrWidth(const uint8_t* font, const char* text) {
+    const GlyphWidths* g = glyphWidths(font);
+    if (g == nullptr) return u8g2.getStrWidth(text);
+
+    int16_t width = 0;
+    for (const char* c = text; *c; c++) {
+        int slot = glyphSlot(*c);
+        if (slot < 0 || g->advance[slot] < 0) return u8g2.getStrWidth(text);
+        width += c[1] ? g->advance[slot] : g->last[slot];
+    }
+    return width;
+}
+
+// What CELL_NAME_ID shows besides the name, a change means placing the layout again
+static uint32_t channelKey(int channel) {
+    return customCANID[channel] | (uint32_t)customMux[channel] << 16;
+}
+
+static int slotChannel(uint8_t slot) {
+    int channel = selectedCANID[slot];
+    return channel >= 0 && channel < PARAM_COUNT ? channel : -1;     // -1 while the selection is being edited
+}
+
+bool LayoutEngine::needsPrepare(const ScreenLayout& layout) const {
+    if (current != &layout) return true;
+    for (int s = 0; s < layout.slots; s++) {
+        int channel = slotChannel(s);
+        if (channel != channels[s]) return true;
+        if (channel >= 0 && channelKey(channel) != ids[s]) return true;
+    }
+    return false;
+}
+
+int16_t LayoutEngine::alignedX(const LayoutCell& cell, const char* text) {
+    return cell.align == ALIGN_RIGHT ? cell.x - cachedStrWidth(cell.font, text) : cell.x;
+}
+
+void LayoutEngine::prepare(const ScreenLayout& layout) {
+    current = &layout;
+    for (int s = 0; s < layout.slots; s++) {
+        channels[s] = slotChannel(s);
+        ids[s] = channels[s] >= 0 ? channelKey(channels[s]) : 0;
+    }
+
+    // Everything but the values is fixed until the layout or selection changes
+    placedCount = layout.cellCount < MAX_LAYOUT_CELLS ? layout.cellCount : MAX_LAYOUT_CELLS;
+    for (int i = 0; i < placedCount; i++) {
+        const LayoutCell& cell = layout.cells[i];
+        PlacedCell& p = placed[i];
+        p.cell = &cell;
+        p.channel = cell.slot < layout.slots ? channels[cell.slot] : -1;
+        p.formatted = false;
+        p.text[0] = '\0';
+        p.x = cell.x;
+        if (p.channel < 0) continue;
+
+        switch (cell.kind) {
+        case CELL_NAME:
+            snprintf(p.text, sizeof(p.text), "%s", paramList[p.channel]);
+            break;
+        case CELL_NAME_ID:
+            if (canManager.isDerived(p.channel)) {
+                snprintf(p.text, sizeof(p.text), "%s", paramList[p.channel]);     // Derived, no ID
+            }
+            else if (customMux[p.channel] != CAN_MUX_NONE) {
+                snprintf(p.text, sizeof(p.text), "%s, 0x%02X/%02X", paramList[p.channel], customCANID[p.channel], customMux[p.channel]);
+            }
+            else {
+                snprintf(p.text, sizeof(p.text), "%s, 0x%02X", paramList[p.channel], customCANID[p.channel]);
+            }
+            break;
+        case CELL_UNIT:
+            snprintf(p.text, sizeof(p.text), "%s", paramUnits[p.channel]);
+            break;
+        case CELL_VALUE:
+        case CELL_PEAK:
+            continue;                   // Formatted per frame
+        }
+        u8g2.setFont(cell.font);
+        p.x = alignedX(cell, p.text);
+    }
+
+    // Names and units only change with the layout, rasterize them once
+    u8g2.clearBuffer();
+    for (int i = 0; i < placedCount; i++) {
+        const PlacedCell& p = placed[i];
+        if (p.channel < 0 || p.cell->kind == CELL_VALUE || p.cell->kind == CELL_PEAK) continue;
+        u8g2.setFont(p.cell->font);
+        u8g2.drawStr(p.x, p.cell->y, p.text);
+    }
+    memcpy(background, u8g2.getBufferPtr(), frameBytes());
+}
+
+size_t LayoutEngine::frameBytes() {
+    size_t bytes = (size_t)u8g2.getBufferTileWidth() * u8g2.getBufferTileHeight() * 8;
+    return bytes < sizeof(background) ? bytes : sizeof(background);
+}
+
+void LayoutEngine::formatValue(PlacedCell& p) {
+    const ChannelValue& value = canSnapshot.values[p.channel];
+    bool fresh = canSnapshot.isFresh(p.channel);
+    if (p.formatted && value.seq == p.seq && fresh == p.fresh) return;     // Same text as last frame
+
+    p.seq = value.seq;
+    p.fresh = fresh;
+    p.formatted = true;
+    if (!fresh) {
+        strcpy(p.text, "---");
+    }
+    else {
+        int precision = p.cell->precision >= 0 ? p.cell->precision : paramPrecision[p.channel];
+        int32_t shown = rescaleFixed(value.value, canSnapshot.decimals[p.channel], precision);
+        formatScaled(p.text, sizeof(p.text), shown, precision);
+    }
+    p.x = alignedX(*p.cell, p.text);
+}
+
+void LayoutEngine::formatPeak(PlacedCell& p) {
+    const ChannelStats& stats = canStats.channels[p.channel];
+    int32_t peak = stats.windowMax[PEAK_HOLD_WINDOW];
+    bool fresh = canSnapshot.isFresh(p.channel) && stats.count > 0;
+    if (p.formatted && (uint32_t)peak == p.seq && fresh == p.fresh) return;
+
+    p.seq = (uint32_t)peak;
+    p.fresh = fresh;
+    p.formatted = true;
+    p.text[0] = '^';
+    if (!fresh) {
+        strcpy(p.text + 1, "---");
+    }
+    else {
+        int precision = p.cell->precision >= 0 ? p.cell->precision : paramPrecision[p.channel];
+        int32_t shown = rescaleFixed(peak, canSnapshot.decimals[p.channel], precision);
+        formatScaled(p.text + 1, sizeof(p.text) - 1, shown, precision);
+    }
+    p.x = alignedX(*p.cell, p.text);
+}
+
+void LayoutEngine::draw(const ScreenLayout& layout) {
+    if (needsPrepare(layout)) prepare(layout);
+    memcpy(u8g2.getBufferPtr(), background, frameBytes());
+
+    const uint8_t* font = nullptr;
+    for (int i = 0; i < placedCount; i++) {
+        PlacedCell& p = placed[i];
+        if (p.channel < 0 || (p.cell->kind != CELL_VALUE && p.cell->kind != CELL_PEAK)) continue;
+        if (p.cell->font != font) {
+            font = p.cell->font;
+            u8g2.setFont(font);
+        }
+        if (p.cell->kind == CELL_PEAK) formatPeak(p);
+        else formatValue(p);
+        u8g2.drawStr(p.x, p.cell->y, p.text);
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Data screens described as tables instead of code. A layout is a list of cells, each one
+// showing one thing about the channel in a slot (selectedCANID[slot]) at a fixed anchor:
+//   { CELL_VALUE, 0, 95, 1, ALIGN_RIGHT, -1, u8g2_font_bytesize_tr }
+// LayoutEngine places everything once when a layout is first drawn (or the selected channels
+// change) and rasterizes the names and units into a background copy of the frame. After that
+// a frame is that copy plus the values, only re-formatting the ones that changed.
+// Peaks (CELL_PEAK) are just more values: the stats come with the snapshot, already computed
+// at ingest, so a peak-hold layout costs one more cached drawStr() per channel.
+
+#define MAX_LAYOUT_CELLS 32
+#define LAYOUT_BUFFER_BYTES 1024        // 128x64 frame, one bit per pixel
+#define GLYPH_CACHE_FONTS 4             // Fonts cachedStrWidth() keeps tables for
+
+// getStrWidth() for the current font, which must be `font`. Strings made of " -.0-9A-Fx"
+// (values, IDs) are measured from per-font advance tables built on first use instead of
+// walking the font data, anything else falls back to getStrWidth().
+int16_t cachedStrWidth(const uint8_t* font, const char* text);
+
+enum CellKind : uint8_t {
+    CELL_NAME,                          // paramList[] name
+    CELL_NAME_ID,                       // Name and CAN ID, "Boost, 0x1A0"
+    CELL_VALUE,                         // Latest value, "---" when stale
+    CELL_UNIT,
+    CELL_PEAK                           // Highest value over PEAK_HOLD_WINDOW, "^123", from canStats
+};
+
+enum CellAlign : uint8_t {
+    ALIGN_LEFT,                         // x is the left edge
+    ALIGN_RIGHT                         // x is the right edge
+};
+
+struct LayoutCell {
+    CellKind kind;
+    uint8_t slot;                       // Index into selectedCANID[]
+    uint8_t x, y;
+    CellAlign align;
+    int8_t precision;                   // CELL_VALUE/CELL_PEAK decimals, -1 = the channel's default
+    const uint8_t* font;
+};
+
+struct ScreenLayout {
+    const LayoutCell* cells;
+    uint8_t cellCount;
+    uint8_t slots;                      // Channels shown, cells use slot < slots
+};
+
+class LayoutEngine {
+public:
+    void draw(const ScreenLayout& layout);  // Replaces the u8g2 buffer, caller sends
+    void invalidate() { current = nullptr; }
+
+private:
+    struct PlacedCell {
+        const LayoutCell* cell;
+        int channel;                    // -1 = nothing selected, cell skipped
+        int16_t x;                      // Left edge after alignment
+        char text[20];
+        uint32_t seq;                   // Channel sequence number (CELL_PEAK: the peak) text was formatted for
+        bool fresh;
+        bool formatted;
+    };
+
+    bool needsPrepare(const ScreenLayout& layout) const;
+    void prepare(const ScreenLayout& layout);
+    void formatValue(PlacedCell& placed);
+    void formatPeak(PlacedCell& placed);
+    int16_t alignedX(const LayoutCell& cell, const char* text);
+    size_t frameBytes();
+
+    const ScreenLayout* current = nullptr;
+    int channels[8];                    // selectedCANID[] and the IDs the layout was placed for
+    uint32_t ids[8];
+    PlacedCell placed[MAX_LAYOUT_CELLS];
+    uint8_t placedCount = 0;
+    uint8_t background[LAYOUT_BUFFER_BYTES];    // Frame with only the static cells drawn
+};
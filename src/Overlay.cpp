@@ -0,0 +1,60 @@
+#include "Overlay.h"
+
+#define TOAST_PADDING 4                 // Between the frame and the text
+#define TOAST_LINE_GAP 2
+
+void Overlay::toast(OverlayLine first, OverlayLine second, uint32_t durationMs, uint32_t nowMs) {
+    kind = TOAST;
+    lines[0] = first;
+    lines[1] = second;
+    shownMs = nowMs;
+    this->durationMs = durationMs;
+}
+
+void Overlay::splash(const uint8_t* bitmap, uint32_t durationMs, uint32_t nowMs) {
+    kind = SPLASH;
+    this->bitmap = bitmap;
+    shownMs = nowMs;
+    this->durationMs = durationMs;
+}
+
+bool Overlay::visible(uint32_t nowMs) {
+    if (kind != NONE && nowMs - shownMs >= durationMs) kind = NONE;
+    return kind != NONE;
+}
+
+void Overlay::draw(U8G2& display) {
+    if (kind == SPLASH) {
+        display.clearBuffer();
+        display.setDrawColor(1);
+        display.drawXBMP(0, 0, display.getDisplayWidth(), display.getDisplayHeight(), bitmap);
+        return;
+    }
+    if (kind != TOAST) return;
+
+    // Size the box around the lines, then center everything
+    int count = lines[1].text ? 2 : 1;
+    int widths[2], heights[2];
+    int boxW = 0, boxH = 2 * TOAST_PADDING + (count - 1) * TOAST_LINE_GAP;
+    for (int i = 0; i < count; i++) {
+        display.setFont(lines[i].font);
+        widths[i] = display.getStrWidth(lines[i].text);
+        heights[i] = display.getMaxCharHeight();
+        if (widths[i] + 2 * TOAST_PADDING > boxW) boxW = widths[i] + 2 * TOAST_PADDING;
+        boxH += heights[i];
+    }
+    int x = (display.getDisplayWidth() - boxW) / 2;
+    int y = (display.getDisplayHeight() - boxH) / 2;
+
+    display.setDrawColor(0);
+    display.drawBox(x, y, boxW, boxH);
+    display.setDrawColor(1);
+    display.drawFrame(x, y, boxW, boxH);
+
+    int lineY = y + TOAST_PADDING;
+    for (int i = 0; i < count; i++) {
+        display.setFont(lines[i].font);
+        display.drawStr((display.getDisplayWidth() - widths[i]) / 2, lineY, lines[i].text);
+        lineY += heights[i] + TOAST_LINE_GAP;
+    }
+}
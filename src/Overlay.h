@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include <U8g2lib.h>
+
+// Transient messages drawn over whatever screen is up ("Saved!", the boot logo). Nothing
+// waits on them: doMenus() keeps composing the screen underneath with live data, sendFrame()
+// draws the overlay on top, and it disappears by itself once its time is up.
+
+struct OverlayLine {
+    const char* text;                   // Must outlive the overlay (literals)
+    const uint8_t* font;
+};
+
+class Overlay {
+public:
+    // Framed box in the middle of the screen, second line optional
+    void toast(OverlayLine first, OverlayLine second, uint32_t durationMs, uint32_t nowMs);
+    void toast(OverlayLine first, uint32_t durationMs, uint32_t nowMs) { toast(first, {nullptr, nullptr}, durationMs, nowMs); }
+    void splash(const uint8_t* bitmap, uint32_t durationMs, uint32_t nowMs);   // Full screen XBM, covers everything
+    void dismiss() { kind = NONE; }
+
+    bool visible(uint32_t nowMs);       // Expires the overlay once its time is up
+    bool isSplash() const { return kind == SPLASH; }
+    void draw(U8G2& display);           // Over the composed frame, leaves draw color 1 and the last line's font
+
+private:
+    enum Kind : uint8_t { NONE, TOAST, SPLASH };
+
+    Kind kind = NONE;
+    OverlayLine lines[2];
+    const uint8_t* bitmap = nullptr;
+    uint32_t shownMs = 0;
+    uint32_t durationMs = 0;
+};
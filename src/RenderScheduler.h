@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+
+#ifndef MAX_REFRESH_HZ
+#define MAX_REFRESH_HZ 60
+#endif
+
+// Decides when doMenus() redraws. Instead of composing and pushing every pass, a frame
+// is drawn only if the screen would look different: the state signature (menu position,
+// shown values, freshness) changed, someone invalidate()d, or an animation is running.
+// Never faster than the max refresh rate.
+class RenderScheduler {
+public:
+    void setMaxRefreshHz(uint16_t hz) { intervalMs = hz ? (1000 + hz - 1) / hz : 0; }
+    uint16_t frameIntervalMs() const { return intervalMs; }
+
+    void invalidate() { dirty = true; }                    // Input, or something else drew over the screen
+    void setAnimating(bool on) { animating = on; }
+
+    bool shouldRender(uint32_t signature, uint32_t nowMs) const {
+        if (!dirty && !animating && signature == lastSignature) return false;
+        return !hasRendered || nowMs - lastRenderMs >= intervalMs;   // First frame doesn't wait
+    }
+
+    // The frame for this signature is on the panel
+    void rendered(uint32_t signature, uint32_t nowMs) {
+        lastSignature = signature;
+        lastRenderMs = nowMs;
+        hasRendered = true;
+        dirty = false;
+        renders++;
+    }
+
+    // How long loop() can sleep before anything could be drawn again
+    uint32_t idleMs(uint32_t nowMs) const {
+        if (!hasRendered) return 0;     // dirty until the first frame
+        uint32_t since = nowMs - lastRenderMs;
+        if (since < intervalMs) return intervalMs - since;
+        return dirty || animating ? 0 : intervalMs;
+    }
+
+    uint32_t framesRendered() const { return renders; }
+
+private:
+    uint16_t intervalMs = (1000 + MAX_REFRESH_HZ - 1) / MAX_REFRESH_HZ;
+    bool dirty = true;                  // Nothing drawn yet
+    bool hasRendered = false;           // lastRenderMs means something
+    bool animating = false;
+    uint32_t lastSignature = 0;
+    uint32_t lastRenderMs = 0;
+    uint32_t renders = 0;
+};
@@ -0,0 +1,49 @@
+/*
+CANBUS COMMANDER BENCHMARKS
+Entry point for [env:native_bench] and [env:esp32s3_bench]: runs src/bench once
+and prints JSON lines (stdout on the host, USB serial on the device).
+*/
+
+#include "benchmark.h"
+#include "KS0108Sink.h"
+
+U8G2_KS0108_128X64_F u8g2(U8G2_R0, 4, 5, 6, 7, 15, 16, 17, 18, /*enable=*/ 10, /*dc=*/ 9, /*cs0=*/ 3, /*cs1=*/ 46, /*cs2=*/ U8X8_PIN_NONE, /* reset=*/  U8X8_PIN_NONE);
+CANDataManager canManager;
+KS0108Sink ks0108Sink(u8g2);            // Host: the U8g2lib stand-in drops the bytes, the diff still runs
+
+void canSetup() {
+    // Benchmarks feed frames themselves, the bus stays off
+}
+
+#ifdef ARDUINO
+PreferencesStore preferencesStore;
+KeyValueStore& preferences = preferencesStore;
+
+void setup() {
+    initPins();
+    Serial.begin(115200);
+    delay(2000);                        // Give the host time to open the port
+    digitalWrite(SCREEN_ON, HIGH);
+    u8g2.begin();
+    frameSink = &ks0108Sink;
+    u8g2_prepare();
+
+    runBenchmarks("esp32s3");
+}
+
+void loop() {
+    delay(1000);
+}
+#else
+MemoryStore memoryStore;
+KeyValueStore& preferences = memoryStore;
+
+int main(int argc, char** argv) {
+    u8g2.begin();
+    frameSink = &ks0108Sink;
+    u8g2_prepare();
+
+    runBenchmarks("native");
+    return 0;
+}
+#endif
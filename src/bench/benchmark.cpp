@@ -0,0 +1,595 @@
+#include "benchmark.h"
+#include "FixedFormat.h"
+#include "DataLogger.h"
+#include <algorithm>
+
+// Sits in front of the real sink and timestamps every present()
+class TimingSink : public FramebufferSink {
+public:
+    explicit TimingSink(FramebufferSink* target) : target(target) {}
+    void present(const uint8_t* buffer, uint8_t tileWidth, uint8_t tileHeight) override {
+        startUs = halMicros();
+        target->present(buffer, tileWidth, tileHeight);
+        endUs = halMicros();
+        frames++;
+        if (onPresent) onPresent(endUs);
+    }
+    uint32_t lastTransferBytes() const override { return target->lastTransferBytes(); }
+
+    FramebufferSink* target;
+    uint32_t startUs = 0, endUs = 0;
+    uint32_t frames = 0;
+    void (*onPresent)(uint32_t endUs) = nullptr;
+};
+
+// Channel i listens on 0x100 + i, the rest are unassigned
+static void assignChannels(int count) {
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        canManager.setCustomID(i, i < count ? 0x100 + i : CAN_ID_UNASSIGNED);
+    }
+}
+
+static CANFrame benchFrame(uint32_t id, uint8_t value) {
+    CANFrame frame = {};
+    frame.identifier = id;
+    frame.timestampUs = halMicros();
+    frame.dlc = 8;
+    frame.data[0] = value;
+    frame.data[1] = value ^ 0x5A;
+    return frame;
+}
+
+/***************** DECODE *********************/
+
+void benchDecode() {
+    static const int counts[] = {1, 2, 4, 8};
+    const int batch = CAN_RING_SIZE - 1;
+
+    for (int count : counts) {
+        if (count > MAX_CHANNELS) break;
+        canManager.begin(nullptr);
+        assignChannels(count);
+
+        // Only update() is timed, inject() just fills the ring it drains
+        uint32_t totalUs = 0;
+        int sent = 0;
+        while (sent < BENCH_DECODE_FRAMES) {
+            int n = std::min(batch, BENCH_DECODE_FRAMES - sent);
+            for (int i = 0; i < n; i++) {
+                canManager.inject(benchFrame(0x100 + (sent + i) % count, (uint8_t)(sent + i)));
+            }
+            uint32_t start = halMicros();
+            canManager.update();
+            totalUs += halMicros() - start;
+            sent += n;
+        }
+
+        halLog("{\"bench\":\"decode\",\"channels\":%d,\"frames\":%d,\"dropped\":%u,\"us\":%u,\"frames_per_s\":%.1f}\n",
+               count, sent, canManager.framesDropped(), totalUs, sent * 1e6 / (totalUs ? totalUs : 1));
+    }
+}
+
+// 1/2/4/8 channels all on 0x180, told apart by the mux value in data[0] like the ECU's
+// multiplexed frames, so the same frame count as benchDecode() through the mux table
+void benchDecodeMux() {
+    static const int counts[] = {1, 2, 4, 8};
+    const int batch = CAN_RING_SIZE - 1;
+
+    for (int count : counts) {
+        if (count > MAX_CHANNELS) break;
+        canManager.begin(nullptr);
+        for (int i = 0; i < MAX_CHANNELS; i++) {
+            canManager.setCustomID(i, i < count ? 0x180 : CAN_ID_UNASSIGNED, CANMux{0, (uint8_t)i});
+        }
+
+        uint32_t totalUs = 0;
+        int sent = 0;
+        while (sent < BENCH_DECODE_FRAMES) {
+            int n = std::min(batch, BENCH_DECODE_FRAMES - sent);
+            for (int i = 0; i < n; i++) {
+                CANFrame frame = benchFrame(0x180, (uint8_t)((sent + i) % count));
+                frame.data[2] = (uint8_t)(sent + i);
+                canManager.inject(frame);
+            }
+            uint32_t start = halMicros();
+            canManager.update();
+            totalUs += halMicros() - start;
+            sent += n;
+        }
+
+        halLog("{\"bench\":\"decode_mux\",\"channels\":%d,\"frames\":%d,\"dropped\":%u,\"us\":%u,\"frames_per_s\":%.1f}\n",
+               count, sent, canManager.framesDropped(), totalUs, sent * 1e6 / (totalUs ? totalUs : 1));
+    }
+}
+
+// 8 raw channels with and without the paramDerived[] channels reading them, and one
+// program's evaluate() on its own
+void benchDerived() {
+    const int batch = CAN_RING_SIZE - 1;
+    float framesPerS[2];
+
+    for (int pass = 0; pass < 2; pass++) {
+        canManager.begin(nullptr);
+        assignChannels(PARAM_DERIVED_FIRST);
+        if (pass == 1) derivedSetup();
+
+        uint32_t totalUs = 0;
+        int sent = 0;
+        while (sent < BENCH_DECODE_FRAMES) {
+            int n = std::min(batch, BENCH_DECODE_FRAMES - sent);
+            for (int i = 0; i < n; i++) {
+                canManager.inject(benchFrame(0x100 + (sent + i) % PARAM_DERIVED_FIRST, (uint8_t)(sent + i)));
+            }
+            uint32_t start = halMicros();
+            canManager.update();
+            totalUs += halMicros() - start;
+            sent += n;
+        }
+        framesPerS[pass] = sent * 1e6f / (totalUs ? totalUs : 1);
+    }
+
+    ChannelSnapshot snap;
+    canManager.snapshot(snap);
+    float toPhysical[MAX_CHANNELS];
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        toPhysical[i] = SCALING_TO_PHYSICAL[snap.decimals[i]];
+    }
+    DerivedProgram program;
+    program.compile(paramDerived[2], paramPrecision[PARAM_DERIVED_FIRST + 2]);   // Rev/Spd, a divide and a max
+    volatile int32_t sink = 0;
+    uint32_t start = halMicros();
+    for (int n = 0; n < BENCH_SNAPSHOT_READS; n++) {
+        sink = sink + program.evaluate(snap.values, toPhysical);
+    }
+    uint32_t evalUs = halMicros() - start;
+
+    halLog("{\"bench\":\"derived\",\"channels\":%d,\"derived\":%d,\"frames\":%d,\"raw_frames_per_s\":%.1f,"
+           "\"frames_per_s\":%.1f,\"eval_ns\":%.1f}\n",
+           PARAM_DERIVED_FIRST, PARAM_COUNT - PARAM_DERIVED_FIRST, BENCH_DECODE_FRAMES, framesPerS[0], framesPerS[1],
+           evalUs * 1000.0f / BENCH_SNAPSHOT_READS);
+}
+
+/***************** SNAPSHOT *********************/
+
+void benchSnapshot() {
+    canManager.begin(nullptr);
+    assignChannels(MAX_CHANNELS);
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        canManager.inject(benchFrame(0x100 + i, (uint8_t)i));
+    }
+    canManager.update();
+
+    // What a screen paid per frame before: one getData() + isDataFresh() per channel
+    volatile float sink = 0;
+    uint32_t start = halMicros();
+    for (int n = 0; n < BENCH_SNAPSHOT_READS; n++) {
+        for (int i = 0; i < MAX_CHANNELS; i++) {
+            if (canManager.isDataFresh(i)) sink = sink + canManager.getData(i);
+        }
+    }
+    uint32_t perChannelUs = halMicros() - start;
+
+    ChannelSnapshot snap;
+    start = halMicros();
+    for (int n = 0; n < BENCH_SNAPSHOT_READS; n++) {
+        canManager.snapshot(snap);
+        sink = sink + snap.fresh;
+    }
+    uint32_t snapshotUs = halMicros() - start;
+
+    // Same with the stats, what doMenus() pays while peak hold is on
+    ChannelStatsSnapshot stats;
+    start = halMicros();
+    for (int n = 0; n < BENCH_SNAPSHOT_READS; n++) {
+        canManager.snapshot(snap, stats);
+        sink = sink + stats.channels[0].count;
+    }
+    uint32_t statsUs = halMicros() - start;
+
+    halLog("{\"bench\":\"snapshot\",\"channels\":%d,\"reads\":%d,\"per_channel_ns\":%.1f,\"snapshot_ns\":%.1f,\"stats_snapshot_ns\":%.1f}\n",
+           MAX_CHANNELS, BENCH_SNAPSHOT_READS, perChannelUs * 1000.0f / BENCH_SNAPSHOT_READS,
+           snapshotUs * 1000.0f / BENCH_SNAPSHOT_READS, statsUs * 1000.0f / BENCH_SNAPSHOT_READS);
+}
+
+/***************** FORMAT *********************/
+
+void benchFormat() {
+    static float values[BENCH_FORMAT_VALUES];
+    srand(1);
+    for (int i = 0; i < BENCH_FORMAT_VALUES; i++) {
+        values[i] = (rand() % 2000000 - 1000000) / 137.0f;     // +-7300, like rpm/temps/volts
+    }
+
+    char buffer[24];
+    volatile int sink = 0;              // Keeps the calls from being optimized out
+    for (int decimals = 0; decimals <= 2; decimals++) {
+        uint32_t start = halMicros();
+        for (int i = 0; i < BENCH_FORMAT_VALUES; i++) {
+            sink += snprintf(buffer, sizeof(buffer), "%.*f", decimals, values[i]);
+        }
+        uint32_t printfUs = halMicros() - start;
+
+        start = halMicros();
+        for (int i = 0; i < BENCH_FORMAT_VALUES; i++) {
+            sink += formatFixed(buffer, sizeof(buffer), values[i], decimals);
+        }
+        uint32_t fixedUs = halMicros() - start;
+
+        halLog("{\"bench\":\"format\",\"decimals\":%d,\"values\":%d,\"snprintf_ns\":%.1f,\"fixed_ns\":%.1f,\"speedup\":%.2f}\n",
+               decimals, BENCH_FORMAT_VALUES, printfUs * 1000.0f / BENCH_FORMAT_VALUES, fixedUs * 1000.0f / BENCH_FORMAT_VALUES,
+               (float)printfUs / (fixedUs ? fixedUs : 1));
+    }
+}
+
+/***************** RENDER *********************/
+
+struct BenchScreen {
+    const char* name;
+    void (*draw)();
+};
+
+static void chan_4_peak() { peakHold = true; chan_4(); peakHold = false; }
+static void chan_8_peak() { peakHold = true; chan_8(); peakHold = false; }
+
+static const BenchScreen SCREENS[] = {
+    {"mainMenu", mainMenu},
+    {"chanSelect", chanSelect},
+    {"canID_config", canID_config},
+    {"setCANID", setCANID},
+    {"modeMenu", modeMenu},
+    {"chan_1", chan_1},
+    {"chan_2", chan_2},
+    {"chan_4", chan_4},
+    {"chan_8", chan_8},
+    {"chan_4_peak", chan_4_peak},
+    {"chan_8_peak", chan_8_peak},
+    {"graph", graphScreen},
+};
+
+void benchRender() {
+    TimingSink timing(frameSink);
+    frameSink = &timing;
+
+    canManager.begin(nullptr);
+    assignChannels(8);
+    for (int i = 0; i < 8; i++) {
+        selectedCANID[i] = i;
+    }
+
+    for (const BenchScreen& screen : SCREENS) {
+        uint32_t composeSum = 0, composeMax = 0, presentSum = 0, presentMax = 0, bytesSum = 0;
+        for (int n = 0; n < BENCH_RENDER_ITERATIONS; n++) {
+            // Fresh values every pass so the number paths are drawn, not "---"
+            for (int i = 0; i < 8; i++) {
+                canManager.inject(benchFrame(0x100 + i, (uint8_t)(n * 7 + i)));
+            }
+            canManager.update();
+            canManager.snapshot(canSnapshot, canStats);     // As doMenus() does before drawing
+
+            // Compose = entry until present()
+            uint32_t start = halMicros();
+            screen.draw();
+            uint32_t compose = timing.startUs - start;
+            uint32_t present = timing.endUs - timing.startUs;
+            composeSum += compose;
+            presentSum += present;
+            bytesSum += timing.lastTransferBytes();
+            composeMax = std::max(composeMax, compose);
+            presentMax = std::max(presentMax, present);
+        }
+        halLog("{\"bench\":\"render\",\"screen\":\"%s\",\"iterations\":%d,\"compose_us\":%.1f,\"compose_max_us\":%u,"
+               "\"present_us\":%.1f,\"present_max_us\":%u,\"present_bytes\":%.1f}\n",
+               screen.name, BENCH_RENDER_ITERATIONS, (float)composeSum / BENCH_RENDER_ITERATIONS, composeMax,
+               (float)presentSum / BENCH_RENDER_ITERATIONS, presentMax, (float)bytesSum / BENCH_RENDER_ITERATIONS);
+    }
+
+    frameSink = timing.target;
+}
+
+/***************** LATENCY *********************/
+
+// Stands in for TWAI: emits one frame on 0x100 every period, stamped when the ingest task receives it.
+// data[0] carries a sequence number so a presented frame can be traced back to its CAN frame,
+// unless value() says otherwise.
+class BenchCANSource : public CANSource {
+public:
+    bool receive(CANFrame& frame, uint32_t timeoutMs) override {
+        if (emitted >= limit) {
+            halDelay(timeoutMs);
+            return false;
+        }
+        uint32_t now = halMicros();
+        if (emitted == 0) nextUs = now;
+        int32_t waitUs = (int32_t)(nextUs - now);
+        if (waitUs > 0) {
+            uint32_t waitMs = (waitUs + 999) / 1000;
+            halDelay(waitMs < timeoutMs ? waitMs : timeoutMs);
+            return false;
+        }
+        frame = benchFrame(0x100, value ? value(emitted) : (uint8_t)emitted);
+        emitUs[emitted & 0xFF] = frame.timestampUs;
+        emitted = emitted + 1;
+        nextUs += BENCH_LATENCY_PERIOD_US;
+        return true;
+    }
+
+    volatile uint32_t emitted = 0;
+    uint32_t limit = BENCH_LATENCY_FRAMES;
+    uint8_t (*value)(uint32_t n) = nullptr;
+    uint32_t emitUs[256];
+    uint32_t nextUs = 0;
+};
+
+static BenchCANSource latencySource;
+static uint32_t latencyUs[BENCH_LATENCY_FRAMES];
+static int latencyCount = 0;
+static int lastShown = -1;
+
+// Called right after a frame went out: the value it shows is the newest sequence number decoded
+static void recordLatency(uint32_t endUs) {
+    if (!canManager.isDataFresh(0)) return;
+    int shown = (int)canManager.getData(0);
+    if (shown == lastShown || latencyCount >= BENCH_LATENCY_FRAMES) return;
+    lastShown = shown;
+    latencyUs[latencyCount++] = endUs - latencySource.emitUs[shown & 0xFF];
+}
+
+void benchLatency() {
+    TimingSink timing(frameSink);
+    timing.onPresent = recordLatency;
+    frameSink = &timing;
+
+    canManager.begin(&latencySource);
+    assignChannels(1);
+    selectedCANID[0] = 0;               // Knock: raw data[0]
+    latencyCount = 0;
+    lastShown = -1;
+
+    // Same as loop(): decode, redraw if needed, sleep until the next frame slot
+    int screen = menuPos[2];
+    menuPos[2] = SCREEN_CHAN_1;
+    uint32_t rendersBefore = renderScheduler.framesRendered();
+    const uint32_t timeoutMs = BENCH_LATENCY_FRAMES * (BENCH_LATENCY_PERIOD_US / 1000) + 1000;
+    uint32_t start = halMillis();
+    canManager.startIngestTask(0);
+    while (lastShown != (BENCH_LATENCY_FRAMES - 1) % 256 && halMillis() - start < timeoutMs) {
+        canManager.update();
+        doMenus();
+        halDelay(renderScheduler.idleMs(halMillis()));
+    }
+    canManager.stopIngestTask();
+    uint32_t renders = renderScheduler.framesRendered() - rendersBefore;
+    menuPos[2] = screen;
+    frameSink = timing.target;
+
+    if (latencyCount == 0) {
+        halLog("{\"bench\":\"latency\",\"error\":\"no frames shown\"}\n");
+        return;
+    }
+    std::sort(latencyUs, latencyUs + latencyCount);
+    uint64_t sum = 0;
+    for (int i = 0; i < latencyCount; i++) sum += latencyUs[i];
+    halLog("{\"bench\":\"latency\",\"screen\":\"chan_1\",\"emitted\":%u,\"shown\":%d,\"renders\":%u,\"mean_us\":%.1f,"
+           "\"p50_us\":%u,\"p95_us\":%u,\"max_us\":%u}\n",
+           (unsigned)latencySource.emitted, latencyCount, renders, (float)sum / latencyCount,
+           latencyUs[latencyCount / 2], latencyUs[latencyCount * 95 / 100], latencyUs[latencyCount - 1]);
+}
+
+/***************** ALARMS *********************/
+
+static BenchCANSource alarmSource;
+static uint32_t alarmLatencyUs[BENCH_ALARM_SPIKES];
+static int alarmCount = 0;
+static uint32_t alarmRaisesSeen = 0;
+
+// Knock at 10 with a one-frame spike to 100 every BENCH_ALARM_INTERVAL frames
+static uint8_t alarmValue(uint32_t n) {
+    return n % BENCH_ALARM_INTERVAL == BENCH_ALARM_INTERVAL - 1 ? 100 : 10;
+}
+
+// The alarm screen for a new raise just went out: frame received -> presented
+static void recordAlarm(uint32_t endUs) {
+    if (alarmStatus.raises == alarmRaisesSeen || alarmStatus.shown() < 0 || alarmCount >= BENCH_ALARM_SPIKES) return;
+    alarmRaisesSeen = alarmStatus.raises;
+    uint32_t frameUs = alarmStatus.raisedUs - alarmStatus.lastLatencyUs;
+    alarmLatencyUs[alarmCount++] = endUs - frameUs;
+    alarms.acknowledge(alarmStatus.unacknowledged);     // The driver presses a button, so the next one is new
+}
+
+void benchAlarm() {
+    static const uint16_t refreshHz[] = {60, 10};
+    TimingSink timing(frameSink);
+    timing.onPresent = recordAlarm;
+    frameSink = &timing;
+
+    alarms.begin();
+    alarms.setRule(0, paramAlarms[0]);
+    canManager.begin(&alarmSource);
+    canManager.addListener(&alarms);
+    assignChannels(1);
+    selectedCANID[0] = 0;               // Knock: raw data[0]
+    int screen = menuPos[2];
+    menuPos[2] = SCREEN_CHAN_1;
+
+    // Same as loop(): the only thing between a raise and the screen is halWake() cutting the sleep short
+    for (uint16_t hz : refreshHz) {
+        renderScheduler.setMaxRefreshHz(hz);
+        alarmSource.emitted = 0;
+        alarmSource.limit = BENCH_ALARM_SPIKES * BENCH_ALARM_INTERVAL;
+        alarmSource.value = alarmValue;
+        alarmCount = 0;
+        alarms.status(alarmStatus);
+        alarmRaisesSeen = alarmStatus.raises;
+        uint32_t raisesBefore = alarmStatus.raises;
+        const uint32_t timeoutMs = alarmSource.limit * (BENCH_LATENCY_PERIOD_US / 1000) + 1000;
+        uint32_t start = halMillis();
+        canManager.startIngestTask(0);
+        while (alarmCount < BENCH_ALARM_SPIKES && halMillis() - start < timeoutMs) {
+            canManager.update();
+            doMenus();
+            halWaitForWake(renderScheduler.idleMs(halMillis()));
+        }
+        canManager.stopIngestTask();
+
+        AlarmStatus status;
+        alarms.status(status);
+        if (alarmCount == 0) {
+            halLog("{\"bench\":\"alarm\",\"refresh_hz\":%u,\"error\":\"no alarm shown\"}\n", hz);
+            continue;
+        }
+        std::sort(alarmLatencyUs, alarmLatencyUs + alarmCount);
+        uint64_t sum = 0;
+        for (int i = 0; i < alarmCount; i++) sum += alarmLatencyUs[i];
+        halLog("{\"bench\":\"alarm\",\"refresh_hz\":%u,\"raised\":%u,\"shown\":%d,\"raise_max_us\":%u,"
+               "\"mean_us\":%.1f,\"p95_us\":%u,\"max_us\":%u}\n",
+               hz, (unsigned)(status.raises - raisesBefore), alarmCount, status.maxLatencyUs, (float)sum / alarmCount,
+               alarmLatencyUs[alarmCount * 95 / 100], alarmLatencyUs[alarmCount - 1]);
+    }
+
+    renderScheduler.setMaxRefreshHz(MAX_REFRESH_HZ);
+    canManager.removeListener(&alarms);
+    alarms.acknowledge(alarmStatus.unacknowledged);
+    alarms.begin();
+    alarms.status(alarmStatus);
+    menuPos[2] = screen;
+    frameSink = timing.target;
+}
+
+/***************** LOGGER *********************/
+
+#ifdef ARDUINO
+static PartitionLogStorage benchLogStorage;     // Appends a session to the real log area
+#else
+static MemoryLogStorage benchLogStorage;
+#endif
+static DataLogger benchDataLogger;
+
+static uint16_t triangle(uint32_t ms, uint32_t periodMs, uint16_t top) {
+    uint32_t phase = ms % periodMs;
+    uint32_t half = periodMs / 2;
+    return (uint16_t)((phase < half ? phase : periodMs - phase) * top / half);
+}
+
+// Roughly what the car sends on a pull: RPM and boost sweep, speed climbs, temps sit still,
+// the battery voltage flickers by one count, the odd knock blip
+static CANFrame driveFrame(int channel, uint32_t ms) {
+    uint16_t raw = 0;
+    switch (channel) {
+        case 0: raw = ms % 2000 < 20 ? 3 : 0; break;                       // Knock
+        case 1: raw = triangle(ms, 4000, 200); break;                       // Boost
+        case 2: raw = 4 * (1000 + triangle(ms, 5000, 6000)); break;         // Eng Rev, 16 bit /4
+        case 3: raw = 40 + triangle(ms, 20000, 120); break;                 // Speed
+        case 4: raw = 130 + (ms / 3000) % 2; break;                         // Oil Temp
+        case 5: raw = 125; break;                                           // Wtr Temp
+        case 6: raw = 70 + (ms / 7000) % 2; break;                          // Air Temp
+        case 7: raw = 1380 + (ms / 7) % 3; break;                           // BatVolt, 16 bit /100
+    }
+    CANFrame frame = benchFrame(0x100 + channel, (uint8_t)(raw >> 8));
+    frame.data[1] = (uint8_t)raw;
+    if (channel != 2 && channel != 7) frame.data[0] = (uint8_t)raw;         // 8 bit channels
+    return frame;
+}
+
+#ifdef ARDUINO
+// The real bus into the ingest task while raw logging (the most block writes) runs, to see
+// whether frames get lost while an erase has the flash cache off. Listen only, so the bench
+// never ACKs or sends anything on the car's bus. No traffic: frames is 0.
+static TwaiCANSource benchTwaiSource;
+
+static void benchLoggerBus() {
+    twai_general_config_t gConfig = TwaiCANSource::generalConfig(CAN_TXD, CAN_RXD, TWAI_MODE_LISTEN_ONLY);
+    twai_timing_config_t tConfig = TWAI_TIMING_CONFIG_500KBITS();
+    twai_filter_config_t fConfig = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+    if (twai_driver_install(&gConfig, &tConfig, &fConfig) != ESP_OK || twai_start() != ESP_OK) {
+        halLog("{\"bench\":\"logger_bus\",\"error\":\"twai\"}\n");
+        twai_driver_uninstall();
+        return;
+    }
+    if (!benchDataLogger.begin(&benchLogStorage, &canManager)) {
+        twai_stop();
+        twai_driver_uninstall();
+        return;
+    }
+    benchDataLogger.setFormat(LOG_FORMAT_RAW);
+    canManager.begin(&benchTwaiSource);
+    canManager.startIngestTask(0);
+    benchDataLogger.start();
+    uint32_t start = halMillis();
+    halDelay(BENCH_LOG_MS);
+    benchDataLogger.stop();
+    uint32_t elapsedMs = halMillis() - start;
+    canManager.stopIngestTask();
+
+    CANRxLoss loss;
+    benchTwaiSource.rxLoss(loss);       // Driver was installed for this run, so these are its own
+    twai_stop();
+    twai_driver_uninstall();
+
+    LoggerStats stats = benchDataLogger.stats();
+    halLog("{\"bench\":\"logger_bus\",\"format\":\"raw\",\"ms\":%u,\"frames\":%u,\"rx_queue\":%d,\"rx_missed\":%u,\"rx_overrun\":%u,"
+           "\"ring_dropped\":%u,\"blocks\":%u,\"flush_mean_us\":%u,\"flush_max_us\":%u}\n",
+           elapsedMs, canManager.framesReceived(), TWAI_RX_QUEUE_LEN, loss.missed, loss.overrun,
+           canManager.framesDropped(), stats.blocksWritten, stats.meanFlushUs, stats.maxFlushUs);
+}
+#endif
+
+void benchLogger() {
+    static const uint8_t formats[] = {LOG_FORMAT_RAW, LOG_FORMAT_DELTA};
+    float rawBytesPerS = 0;
+
+    for (uint8_t format : formats) {
+        if (!benchDataLogger.begin(&benchLogStorage, &canManager)) {
+            halLog("{\"bench\":\"logger\",\"error\":\"no log area\"}\n");
+            return;
+        }
+        benchDataLogger.setFormat(format);
+        benchDataLogger.setDeadband(7, format == LOG_FORMAT_DELTA ? 1 : 0);   // 10 mV of alternator noise
+        canManager.begin(nullptr);
+        assignChannels(MAX_CHANNELS);
+
+        // Every channel gets a frame every ms while the logger samples and flushes behind it
+        uint32_t maxUpdateUs = 0;
+        uint32_t start = halMillis();
+        benchDataLogger.start();
+        for (uint32_t ms = 0; ms < BENCH_LOG_MS; ms = halMillis() - start) {
+            for (int i = 0; i < MAX_CHANNELS; i++) {
+                canManager.inject(driveFrame(i, ms));
+            }
+            uint32_t updateStart = halMicros();
+            canManager.update();
+            maxUpdateUs = std::max(maxUpdateUs, halMicros() - updateStart);
+            halDelay(1);
+        }
+        benchDataLogger.stop();
+        uint32_t elapsedMs = halMillis() - start;
+
+        LoggerStats stats = benchDataLogger.stats();
+        float bytesPerS = stats.bytesLogged * 1000.0f / (elapsedMs ? elapsedMs : 1);
+        if (format == LOG_FORMAT_RAW) rawBytesPerS = bytesPerS;
+        halLog("{\"bench\":\"logger\",\"format\":\"%s\",\"channels\":%d,\"ms\":%u,\"samples\":%u,\"rate_hz\":%.1f,"
+               "\"samples_dropped\":%u,\"bytes_logged\":%u,\"bytes_per_s\":%.1f,\"vs_raw\":%.2f,\"blocks\":%u,\"bytes\":%u,"
+               "\"flush_errors\":%u,\"flush_mean_us\":%u,\"flush_max_us\":%u,\"max_update_us\":%u}\n",
+               format == LOG_FORMAT_RAW ? "raw" : "delta", MAX_CHANNELS, elapsedMs, stats.samplesLogged,
+               stats.samplesLogged * 1000.0f / (elapsedMs ? elapsedMs : 1), stats.samplesDropped, stats.bytesLogged,
+               bytesPerS, rawBytesPerS / (bytesPerS > 0 ? bytesPerS : 1), stats.blocksWritten, stats.bytesWritten,
+               stats.flushErrors, stats.meanFlushUs, stats.maxFlushUs, maxUpdateUs);
+    }
+#ifdef ARDUINO
+    benchLoggerBus();
+#endif
+}
+
+void runBenchmarks(const char* platform) {
+    halLog("{\"bench\":\"info\",\"platform\":\"%s\",\"max_channels\":%d,\"ring_size\":%d}\n",
+           platform, MAX_CHANNELS, CAN_RING_SIZE);
+    benchDecode();
+    benchDecodeMux();
+    benchDerived();
+    benchSnapshot();
+    benchFormat();
+    benchRender();
+    benchLogger();
+    benchLatency();
+    benchAlarm();
+    halLog("{\"bench\":\"done\"}\n");
+}
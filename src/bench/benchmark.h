@@ -0,0 +1,47 @@
+#pragma once
+#include "screens.h"
+
+// Benchmarks shared by [env:native_bench] and [env:esp32s3_bench].
+// Results go out through halLog() as JSON lines, one object per measurement:
+//   {"bench":"decode","channels":4,"frames":20000,"us":5230,"frames_per_s":3824091.8}
+// Compare two runs with tools/bench_compare.py.
+
+#ifndef BENCH_DECODE_FRAMES
+#define BENCH_DECODE_FRAMES 20000       // Per channel count
+#endif
+#ifndef BENCH_SNAPSHOT_READS
+#define BENCH_SNAPSHOT_READS 10000
+#endif
+#ifndef BENCH_FORMAT_VALUES
+#define BENCH_FORMAT_VALUES 5000        // Per precision
+#endif
+#ifndef BENCH_RENDER_ITERATIONS
+#define BENCH_RENDER_ITERATIONS 50      // Per screen
+#endif
+#ifndef BENCH_LOG_MS
+#define BENCH_LOG_MS 3000               // Logger run time
+#endif
+#ifndef BENCH_LATENCY_FRAMES
+#define BENCH_LATENCY_FRAMES 200
+#endif
+#ifndef BENCH_LATENCY_PERIOD_US
+#define BENCH_LATENCY_PERIOD_US 10000   // 100 Hz, not a multiple of the frame interval so the phase wanders
+#endif
+#ifndef BENCH_ALARM_SPIKES
+#define BENCH_ALARM_SPIKES 20
+#endif
+#ifndef BENCH_ALARM_INTERVAL
+#define BENCH_ALARM_INTERVAL 15         // Frames between knock spikes, at BENCH_LATENCY_PERIOD_US
+#endif
+
+void benchDecode();                     // update() throughput for 1/2/4/8 channels
+void benchDecodeMux();                  // The same with every channel on one ID, picked by mux value
+void benchDerived();                    // The same for 8 channels with and without the derived ones, and one evaluate()
+void benchSnapshot();                   // snapshot() vs per-channel getData()/isDataFresh() reads, and with the stats
+void benchFormat();                     // formatFixed() vs snprintf("%.Nf") per precision
+void benchRender();                     // Compose vs present time per screen
+void benchLogger();                     // DataLogger raw vs delta on drive-like data: size, drops, flush time, update() stalls,
+                                        // and on the device the real bus while logging: TWAI frames missed/overrun during block writes
+void benchLatency();                    // Frame arrival at ingest -> frame containing its value presented
+void benchAlarm();                      // Frame past a threshold -> alarm screen presented, at 60 and 10 Hz refresh caps
+void runBenchmarks(const char* platform);
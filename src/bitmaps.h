@@ -1,5 +1,5 @@
 #pragma once
-#include <Arduino.h>
+#include "Hal.h"
 
 // 'cupBitmap', 32x64px
 const uint8_t cupBitmap [] PROGMEM = {
@@ -0,0 +1,183 @@
+/*
+CANBUS COMMANDER HOST BUILD
+Entry point for [env:native]: the shared screen + decode code running against
+the HAL stand-ins, so it can be exercised and profiled without a car.
+*/
+
+#include "screens.h"
+#include "CANReplay.h"
+#include "DataLogger.h"
+
+U8G2_KS0108_128X64_F u8g2(U8G2_R0, 4, 5, 6, 7, 15, 16, 17, 18, /*enable=*/ 10, /*dc=*/ 9, /*cs0=*/ 3, /*cs1=*/ 46, /*cs2=*/ U8X8_PIN_NONE, /* reset=*/  U8X8_PIN_NONE);
+QueueCANSource hostSource;
+CANDataManager canManager;
+MemoryStore memoryStore;
+KeyValueStore& preferences = memoryStore;
+MemorySink memorySink;
+
+void canSetup() {
+    // Nothing to restart, frames come from hostSource
+}
+
+// Replays a candump/ASC trace through the ingest thread and update(), like the car would
+//   native <trace> [--speed N | --fast] [--id CH=ID[:MUX] ...] [--log out.bin] [--track M]
+// --log runs the data logger along with it and writes the log area out as a partition image.
+// --track times laps of M meters from the speed channel, starting with the first speed frame.
+// Alarms run with the paramAlarms[] rules, the ones still active at the end are listed.
+// The paramDerived[] channels are computed along and listed after the raw ones.
+static int replay(int argc, char** argv) {
+    CANReplaySource::Pacing pacing = CANReplaySource::RecordedTiming;
+    float speed = 1.0f;
+    const char* logPath = nullptr;
+    uint32_t trackM = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--fast") == 0) {
+            pacing = CANReplaySource::AsFastAsPossible;
+        }
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            pacing = CANReplaySource::Scaled;
+            speed = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--track") == 0 && i + 1 < argc) {
+            trackM = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            logPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--id") == 0 && i + 1 < argc) {
+            int channel;
+            unsigned id, mux;
+            int fields = sscanf(argv[++i], "%d=%x:%x", &channel, &id, &mux);
+            if (fields >= 2 && channel >= 0 && channel < PARAM_DERIVED_FIRST) {
+                customCANID[channel] = id;
+                customMux[channel] = fields == 3 ? (uint8_t)mux : CAN_MUX_NONE;   // 2=180:0B, data[PARAM_MUX_BYTE] == 0x0B
+            }
+        }
+    }
+
+    FileLineReader reader(argv[1]);
+    if (!reader.isOpen()) {
+        halLog("can't open %s\n", argv[1]);
+        return 1;
+    }
+    CANReplaySource replaySource(reader, pacing, speed);
+    canManager.begin(&replaySource);
+    for (int i = 0; i < PARAM_DERIVED_FIRST; i++) {
+        canManager.setCustomID(i, customCANID[i], paramMux(i));
+    }
+    derivedSetup();
+
+    if (trackM) {
+        lapTimer.begin(LAP_SPEED_CHANNEL);
+        lapTimer.setTrackLength(trackM);
+        lapTimer.trigger();             // Start/finish at the first speed frame
+        canManager.addListener(&lapTimer);
+    }
+    alarms.begin();
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        alarms.setRule(i, paramAlarms[i]);
+    }
+    canManager.addListener(&alarms);
+
+    MemoryLogStorage logStorage;
+    DataLogger logger;
+    if (logPath != nullptr) {
+        logger.begin(&logStorage, &canManager);
+    }
+
+    uint32_t start = halMicros();
+    canManager.startIngestTask();
+    if (logPath != nullptr) {
+        logger.start();
+    }
+    while (!replaySource.finished()) {
+        canManager.update();
+        halDelay(1);
+    }
+    logger.stop();
+    canManager.stopIngestTask();
+    canManager.update();
+    uint32_t elapsedUs = halMicros() - start;
+
+    halLog("%u frames in %.3f s (%.0f frames/s), %u dropped, %u lines skipped\n",
+           replaySource.framesReplayed(), elapsedUs / 1e6, replaySource.framesReplayed() * 1e6 / (elapsedUs ? elapsedUs : 1),
+           canManager.framesDropped(), replaySource.linesSkipped());
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        if (canManager.isDerived(i)) {
+            halLog("%-8s          %8.2f = %s\n", paramList[i], canManager.getData(i), paramDerived[i - PARAM_DERIVED_FIRST]);
+        }
+        else if (customMux[i] != CAN_MUX_NONE) {
+            halLog("%-8s 0x%03X/%02X %8.2f\n", paramList[i], customCANID[i], customMux[i], canManager.getData(i));
+        }
+        else {
+            halLog("%-8s 0x%03X    %8.2f\n", paramList[i], customCANID[i], canManager.getData(i));
+        }
+    }
+
+    if (trackM) {
+        LapStatus laps;
+        lapTimer.status(laps);
+        halLog("laps: %u, last %.2f s, best %.2f s, %u m into the current one\n",
+               laps.lap, laps.lastLapMs / 1000.0f, laps.bestLapMs / 1000.0f, laps.distanceM);
+    }
+
+    AlarmStatus alarmed;
+    alarms.status(alarmed);
+    halLog("alarms: %u raised, latency last %u us max %u us", alarmed.raises, alarmed.lastLatencyUs, alarmed.maxLatencyUs);
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        if (alarmed.level[i] != ALARM_OK) halLog(", %s %s", paramList[i], alarmed.level[i] == ALARM_CRITICAL ? "critical" : "warning");
+    }
+    halLog("\n");
+
+    if (logPath != nullptr) {
+        LoggerStats stats = logger.stats();
+        halLog("log: %u samples, %u dropped, %u blocks (%u bytes), flush mean %u us max %u us\n",
+               stats.samplesLogged, stats.samplesDropped, stats.blocksWritten, stats.bytesWritten,
+               stats.meanFlushUs, stats.maxFlushUs);
+        if (!logStorage.save(logPath)) {
+            halLog("can't write %s\n", logPath);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Feed one frame per channel, decode, draw the 4 channel screen and dump it
+int main(int argc, char** argv) {
+    u8g2.begin();
+    frameSink = &memorySink;
+    u8g2_prepare();
+
+    for (int i = 0; i < 8; i++) {
+        customCANID[i] = 0x100 + i;
+        selectedCANID[i] = i;
+    }
+    if (argc > 1) {
+        return replay(argc, argv);
+    }
+
+    canManager.begin(&hostSource);
+    for (int i = 0; i < 8; i++) {
+        canManager.setCustomID(i, customCANID[i]);
+    }
+
+    for (int i = 0; i < 8; i++) {
+        CANFrame frame = {};
+        frame.identifier = 0x100 + i;
+        frame.timestampUs = halMicros();
+        frame.dlc = 8;
+        frame.data[0] = 0x20 + 11 * i;
+        frame.data[1] = 0x40;
+        hostSource.push(frame);
+    }
+    canManager.update();
+
+    menuPos[2] = SCREEN_CHAN_4;
+    doMenus();
+    memorySink.print();
+
+    for (int i = 0; i < 4; i++) {
+        halLog("%-8s %8.2f\n", paramList[i], canManager.getData(i));
+    }
+    return 0;
+}
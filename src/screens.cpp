@@ -0,0 +1,1113 @@
+/*
+CANBUS COMMANDER SCREENS & MENUS
+Everything drawn on the LCD. Only talks to the hardware through Hal.h, so the
+firmware (main.cpp) and the host build (native/main_native.cpp) share it.
+*/
+
+/*
+MAIN MENU
+|   Channel Select
+|   |   Data Display
+SETTING
+|   Channel Select
+|   |   Data Select
+|   |   |   Inj Duty Cycle  (Injector Duty Cycle)       [%]
+|   |   |   IgnT Ld         (Leading Ignition Timing)   [deg]
+|   |   |   IgnT Tr         (Trailing Ignition Timing)  [deg]
+|   |   |   Eng Rev         (Engine RPM)                [RPM]
+|   |   |   Speed           (Vehicle Speed)             [km/h]
+|   |   |   Boost           (Intake MAP)                [bar]
+|   |   |   Knock           (Detonation Level)          [!!!]
+|   |   |   WtrTemp         (Water Temperature)         [degC]
+|   |   |   OilTemp         (Oil Temperature)           [degC]
+|   |   |   OilPres         (Oil Pressure)              [bar]
+|   |   |   AirTemp         (Intake Air Temperature)    [degC]
+|   |   |   BatVolt         (Battery Voltage)           [V]
+|   |   |   Lambda          (Air Fuel Ratio Lambda)     []
+ETC
+|   Units
+|   |   Metric
+|   |   Imperial (cringe)
+*/
+
+#include "screens.h"
+#include "bitmaps.h"
+#include "CCfonts.h"
+#include "Layout.h"
+#include "FixedFormat.h"
+
+#define MAX_DROPLETS 5  // Number of spill droplets
+
+bool AUTOSLEEP = false;
+FramebufferSink* frameSink = nullptr;
+RenderScheduler renderScheduler;
+ChannelSnapshot canSnapshot;
+ChannelStatsSnapshot canStats;
+bool peakHold = false;
+ButtonEvents buttons;
+Overlay overlay;
+LapTimer lapTimer;
+LapStatus lapStatus;
+AlarmEngine alarms;
+AlarmStatus alarmStatus;
+
+// Cup position variables
+float cupX = 64;
+float accelTarget = 0.8;
+float velocity = 0;
+float acceleration = 0;
+float damping = 0.85;
+
+// Liquid animation variables
+float liquidOffset = 0;  // The tilt of the liquid surface
+float liquidVelocity = 0;
+float liquidDamping = 0.95;  // Higher damping for smoother motion
+
+// Spill effect
+struct Droplet {
+    float x, y, vy;
+    bool active;
+} droplets[MAX_DROPLETS];
+
+// Function to initialize a new droplet
+void spawnDroplet(float startX, float startY) {
+    for (int i = 0; i < MAX_DROPLETS; i++) {
+        if (!droplets[i].active) {
+            droplets[i] = {startX, startY, (float)random(1, 3) / 2.0f, true};  // Random speed
+            break;
+        }
+    }
+}
+
+int mod(int dividend, int divisor) {
+    return ((dividend % divisor) + divisor) % divisor;
+}
+
+// Buttons
+int upPresses = 0, downPresses = 0, leftPresses = 0, rightPresses = 0, prevPresses = 0, nextPresses = 0;
+
+// Menus
+int menuPos[3] = {0, 0, 0};         // X, Y, PAGE {page0 = home, page1 = settings, page2 = etc, ...}
+static_assert(MAX_CHANNELS >= PARAM_COUNT, "canManager needs a channel per paramList[] entry");
+static_assert(HISTORY_CHANNELS >= PARAM_COUNT, "the graph screen needs history for every paramList[] entry");
+const char * paramList[PARAM_COUNT] = {"Knock", "Boost", "Eng Rev", "Speed", "Oil Temp", "Wtr Temp", "Air Temp", "BatVolt", "BoostPSI", "Oil-Wtr", "Rev/Spd", "Oil/Wtr"};      // Array of parameters!
+const char * paramUnits[PARAM_COUNT] = {"!!!",   "bar",   "rpm",     "km/h",  "deg",      "deg",      "deg",      "V",       "psi",      "deg",     "",        ""};
+const int8_t paramPrecision[PARAM_COUNT] = {0,   1,       0,         0,       1,          1,          1,          2,         1,          1,         0,         2};          // Decimals shown
+const AlarmRule paramAlarms[PARAM_COUNT] = {
+//    on     below  warning  critical  hyst  holdMs
+    { true,  false,  40.0f,   60.0f,   5.0f,    0 },   // Knock, no hold: a single spike counts
+    { false, false,   0.0f,    0.0f,   0.0f,    0 },   // Boost
+    { false, false,   0.0f,    0.0f,   0.0f,    0 },   // Eng Rev
+    { false, false,   0.0f,    0.0f,   0.0f,    0 },   // Speed
+    { true,  false, 120.0f,  130.0f,   2.0f, 1000 },   // Oil Temp
+    { true,  false, 105.0f,  110.0f,   2.0f, 1000 },   // Wtr Temp
+    { false, false,   0.0f,    0.0f,   0.0f,    0 },   // Air Temp
+    { true,  true,   12.0f,   11.5f,   0.2f, 2000 },   // BatVolt, held through cranking dips
+    { false, false,   0.0f,    0.0f,   0.0f,    0 },   // BoostPSI
+    { false, false,   0.0f,    0.0f,   0.0f,    0 },   // Oil-Wtr
+    { false, false,   0.0f,    0.0f,   0.0f,    0 },   // Rev/Spd
+    { false, false,   0.0f,    0.0f,   0.0f,    0 },   // Oil/Wtr
+};
+// Channels the ECU doesn't send, $n = paramList[n] (see DerivedChannel.h), paramPrecision[] decimals
+const char * paramDerived[PARAM_COUNT - PARAM_DERIVED_FIRST] = {
+    "$1 * 14.504",                      // BoostPSI: bar to psi
+    "$4 - $5",                          // Oil-Wtr: oil running hotter than water = oil cooler working
+    "$2 / max($3, 5)",                  // Rev/Spd: rpm per km/h, one value per gear
+    "$4 / max($5, 1)",                  // Oil/Wtr
+};
+uint16_t customCANID[12] =   {   0x000,    0x000,      0x000,    0x000,       0x009,       0x000,       0x000,      0x000};      // Stores *CUSTOM* CANBUS ID of all parameters as set by user
+uint8_t customMux[12] = {CAN_MUX_NONE, CAN_MUX_NONE, CAN_MUX_NONE, CAN_MUX_NONE, CAN_MUX_NONE, CAN_MUX_NONE,
+                         CAN_MUX_NONE, CAN_MUX_NONE, CAN_MUX_NONE, CAN_MUX_NONE, CAN_MUX_NONE, CAN_MUX_NONE};   // Value in data[PARAM_MUX_BYTE] each parameter's frames need
+int selectedCANID[8];               // Stores indicies of customCANID[] that are selected by user to be displayed. Index 0 is dataNum1, up to index 7 is dataNum8
+int paramCursor = 8;                // set up to start at zero and count to 7 for each parameter selected.
+int paramLocation[8][2];
+
+int digit = 0;                      // For setCANID() cursor
+
+/***************** PREFERENCES *********************/
+void saveCANIDS() {
+    preferences.begin("myApp", false);
+    preferences.putBytes("customCANIDs", customCANID, sizeof(customCANID));
+    preferences.putBytes("customMuxes", customMux, sizeof(customMux));
+    preferences.putBytes("selectedCANIDs", selectedCANID, sizeof(selectedCANID));
+    preferences.putBytes("paramLocation", paramLocation, sizeof(paramLocation));
+    preferences.end();
+}
+
+void loadCANIDS() {
+    preferences.begin("myApp", true);
+    size_t customBytes = preferences.getBytes("customCANIDs", customCANID, sizeof(customCANID));
+    size_t muxBytes = preferences.getBytes("customMuxes", customMux, sizeof(customMux));
+    size_t selectedBytes = preferences.getBytes("selectedCANIDs", selectedCANID, sizeof(selectedCANID));
+    size_t locationBytes = preferences.getBytes("paramLocation", paramLocation, sizeof(paramLocation));
+    
+    if (customBytes != sizeof(customCANID)) {
+        memset(customCANID, 0, sizeof(customCANID));
+    }
+    if (muxBytes != sizeof(customMux)) {
+        memset(customMux, CAN_MUX_NONE, sizeof(customMux));     // Saved before mux support: nothing multiplexed
+    }
+    if (selectedBytes != sizeof(selectedCANID)) {
+        memset(selectedCANID, 0, sizeof(selectedCANID));
+    }
+    if (locationBytes != sizeof(paramLocation)) {
+        memset(paramLocation, 0, sizeof(paramLocation));
+    }
+
+    preferences.end();
+}
+CANMux paramMux(int param) {
+    return customMux[param] == CAN_MUX_NONE ? CAN_NO_MUX : CANMux{PARAM_MUX_BYTE, customMux[param]};
+}
+/***************************************************/
+
+/***************** DERIVED CHANNELS *********************/
+void derivedSetup() {
+#ifdef CAN_SIGNAL_TABLE
+    return;                             // Channels 8 to 11 are DBC signals, and $n means a different signal there
+#endif
+    for (int i = PARAM_DERIVED_FIRST; i < PARAM_COUNT; i++) {
+        const char* expr = paramDerived[i - PARAM_DERIVED_FIRST];
+        DerivedProgram program;
+        int errorAt = 0;
+        if (!program.compile(expr, paramPrecision[i], &errorAt)) {
+            halLog("%s: can't compile \"%s\" at %d\n", paramList[i], expr, errorAt);
+        }
+        else if (!canManager.setDerived(i, program)) {
+            halLog("%s: reads itself or a later derived channel\n", paramList[i]);
+        }
+    }
+}
+/***************************************************/
+
+void u8g2_prepare(void) {
+  //u8g2.setFont(u8g2_font_lord_mr);
+  u8g2.setFont(u8g2_font_pfc_sans_v1_1_tf);
+  u8g2.setFontRefHeightExtendedText();
+  u8g2.setDrawColor(1);
+  u8g2.setFontPosTop();
+  u8g2.setFontDirection(0);
+}
+
+void sendFrame() {
+    if (alarmStatus.active && alarmStatus.shown() < 0) {
+        // Acknowledged alarms still active: "!" in the top right corner of every screen
+        u8g2.setDrawColor(1);
+        u8g2.drawBox(121, 0, 7, 9);
+        u8g2.setDrawColor(0);
+        u8g2.setFont(u8g2_font_pfc_sans_v1_1_tf);
+        u8g2.drawStr(123, 1, "!");
+        u8g2.setDrawColor(1);
+    }
+    if (overlay.visible(halMillis())) {
+        overlay.draw(u8g2);
+        u8g2.setFont(u8g2_font_pfc_sans_v1_1_tf);   // Screens expect the default font back
+    }
+    frameSink->present(u8g2.getBufferPtr(), u8g2.getBufferTileWidth(), u8g2.getBufferTileHeight());
+    renderScheduler.invalidate();       // Test screens draw outside doMenus(). doMenus() clears it for its own frames
+}
+
+void showBootScreen(uint32_t durationMs) {
+    overlay.splash(boot_logo, durationMs, halMillis());
+    renderScheduler.invalidate();       // Next doMenus() pass draws it, no waiting here
+}
+
+void resetDroplets() {
+    for (int i = 0; i < MAX_DROPLETS; i++) droplets[i].active = false;
+}
+
+/************************************************************/
+
+bool getSW(int SW) {
+    //Serial.println("Button Pressed!");
+
+    switch (SW)
+    {
+    case UP_SW:
+        if (halReadButton(UP_SW)) return 1; else return 0;
+        break;
+    case DOWN_SW:
+        if (halReadButton(DOWN_SW)) return 1; else return 0;
+        break;
+    case LEFT_SW:
+        if (halReadButton(LEFT_SW)) return 1; else return 0;
+        break;
+    case RIGHT_SW:
+        if (halReadButton(RIGHT_SW)) return 1; else return 0;
+        break;
+    case PREV_SW:
+        if (halReadButton(PREV_SW)) return 1; else return 0;
+        break;
+    case NEXT_SW:
+        if (halReadButton(NEXT_SW)) return 1; else return 0;
+        break;
+    default:
+        return 0;
+        break;
+    }
+}
+
+void buttonTest() {
+    u8g2.clearBuffer();
+
+// Menu Alignment Lines
+//  display.drawLine(0,21,128,21, SSD1306_WHITE);
+//  display.drawLine(0,43,128,43, SSD1306_WHITE);
+//  display.drawLine(63,0,63,63, SSD1306_WHITE);
+//  display.drawLine(65,0,65,63, SSD1306_WHITE);
+    u8g2_prepare();
+    //u8g2.setFont(u8g2_font_luRS18_tf);
+    // u8g2.drawStr(23, 5, "monitor");
+    // u8g2.drawStr(23, 25, "setting");
+    // u8g2.drawStr(48,45, "etc.");
+
+    char buffer[10];
+    sprintf(buffer, "   UP: %d", (int)getSW(UP_SW));
+    u8g2.drawStr(0, 0, buffer);;
+
+    sprintf(buffer, " DOWN: %d", (int)getSW(DOWN_SW));
+    u8g2.drawStr(0, 10, buffer);
+
+    sprintf(buffer, " LEFT: %d", (int)getSW(LEFT_SW));
+    u8g2.drawStr(0, 20, buffer);
+
+    sprintf(buffer, "RIGHT: %d", (int)getSW(RIGHT_SW));
+    u8g2.drawStr(0, 30, buffer);
+
+    sprintf(buffer, " PREV: %d", (int)getSW(PREV_SW));
+    u8g2.drawStr(0, 40, buffer);
+
+    sprintf(buffer, " NEXT: %d", (int)getSW(NEXT_SW));
+    u8g2.drawStr(0, 50, buffer);
+
+    // bitmap
+    u8g2.drawXBMP(64, 0, 32, 64, cupBitmap);
+
+    sendFrame();
+}
+
+void cupTest() {
+    // Read accelerometer (pseudo-code)
+    if (halReadButton(RIGHT_SW) && (acceleration < accelTarget)) {
+        acceleration += 0.09;
+    }
+    else if (halReadButton(LEFT_SW) && (acceleration > -accelTarget)) {
+        acceleration -= 0.09;
+    }
+    else {
+        acceleration = 0;
+    }
+    halLog("Acc = %.2f\r\n", acceleration);
+
+    // Update cup movement physics
+    //acceleration = accX * 2.0;
+    velocity += acceleration;
+    velocity *= damping;
+    cupX += velocity;
+
+    // Boundaries
+    if (cupX < 0) { cupX = 0; velocity = 0; acceleration = 0; }
+    if (cupX > 128-32) { cupX = 128-32; velocity = 0; acceleration = 0; }
+
+    // Update liquid movement (sloshing effect)
+    float targetOffset = acceleration * 4;  // More acceleration = more tilt
+    liquidVelocity += (targetOffset - liquidOffset) * 0.25;  // Smooth transition
+    liquidVelocity *= liquidDamping;
+    liquidOffset += liquidVelocity;
+
+    // Check for spill
+    if (fabsf(liquidOffset) > 6) {  // Threshold for spilling
+        spawnDroplet(cupX + (liquidOffset > 0 ? 14 : 2), 42);  // Spawn droplet at spill edge
+    }
+
+    // Update droplets
+    for (int i = 0; i < MAX_DROPLETS; i++) {
+        if (droplets[i].active) {
+            droplets[i].y += droplets[i].vy;  // Apply gravity
+            if (droplets[i].y > 64) droplets[i].active = false;  // Remove if off-screen
+        }
+    }
+
+    // Draw frame
+    u8g2.clearBuffer();
+    
+    // Draw cup bitmap
+    u8g2.drawXBMP((int)cupX, 0, 32, 64, cupBitmap);
+
+    // Draw liquid as a wavy line
+    for (int i = 0; i < 30; i++) {
+        int waveY = 30 + (i-15)*liquidOffset*0.2 + (sin(i * liquidOffset));  // Wavy effect
+        u8g2.drawPixel(cupX + 1 + i, waveY);
+    }
+
+    // Draw spilled droplets
+    for (int i = 0; i < MAX_DROPLETS; i++) {
+        if (droplets[i].active) {
+            u8g2.drawPixel((int)droplets[i].x, (int)droplets[i].y);
+        }
+    }
+
+    sendFrame();
+}
+
+/************************* MENU SELECTION **************************/
+
+void menuSelection(ScreenId menu) {
+    int x, y, width, height;
+    int xShift, yShift;
+    int column = menuPos[0];
+    switch (menu)
+    {
+    case SCREEN_MAIN:
+        x = 15;
+        y = 6;
+        width = 99;
+        height = 15;
+        yShift = 19;
+        xShift = 40;
+        break;
+    case SCREEN_CHANNEL_SELECT:
+        x = 30;
+        y = 12;
+        width = 70;
+        height = 9;
+        yShift = 10;
+        xShift = 40;
+        break;
+    case SCREEN_CANID_CONFIG:
+        x = 3;
+        y = 7;
+        width = 60;
+        height = 9;
+        xShift = 62;
+        yShift = 10;
+
+        column = menuPos[0] % 2;        // Two columns a page, column 2 (the derived channels) is page 1 on its own
+
+        char buffer[5];
+        u8g2.setFont(u8g2_font_pfc_sans_v1_1_tf);
+        for (int i=0; i<paramCursor; i++) {
+            if (paramLocation[i][0] / 2 != menuPos[0] / 2) continue;    // Picked on the other page
+            sprintf(buffer, "%d", i+1);
+            u8g2.drawStr((x + 3) + (paramLocation[i][0] % 2) * xShift, y + paramLocation[i][1] * yShift, buffer); 
+        }
+        break;
+    case SCREEN_MODE:
+        x = 20;
+        y = 8;
+        width = 90;
+        height = 9;
+        yShift = 10;
+        xShift = 40;
+        break;
+    
+    default:
+        break;
+    }
+
+    // if DOWN add ySHIFT to y
+    // if RIGHT add xSHIFT to x
+    u8g2.setDrawColor(2);
+    u8g2.drawBox(x + column * xShift, y + menuPos[1] * yShift, width, height);
+}
+
+void mainMenu() {
+    u8g2.clearBuffer();
+    u8g2.drawXBMP(0, 0, 128, 64, screen_0_main_menu);
+
+    menuSelection(SCREEN_MAIN);
+
+    sendFrame();
+}
+
+void chanSelect() {
+    u8g2.clearBuffer();
+    u8g2.drawXBMP(0, 0, 128, 64, screen_1_channel_select);
+
+    menuSelection(SCREEN_CHANNEL_SELECT);
+
+    sendFrame();
+}
+
+void canID_config() {
+    u8g2.clearBuffer();
+    if (menuPos[0] < 2) {
+        u8g2.drawXBMP(0, 0, 128, 64, screen_3_data_select);
+    }
+    else {                              // Past the bitmap's 8: the derived channels, with the highlighted one's expression
+        u8g2.setFont(u8g2_font_pfc_sans_v1_1_tf);
+        for (int row = 0; row < PARAM_COUNT - PARAM_DERIVED_FIRST; row++) {
+            u8g2.drawStr(14, 8 + 10 * row, paramList[PARAM_DERIVED_FIRST + row]);
+        }
+        u8g2.drawStr(76, 8, "Derived");
+        u8g2.drawStr(3, 52, "=");
+        u8g2.drawStr(10, 52, paramDerived[menuPos[1]]);
+    }
+
+    menuSelection(SCREEN_CANID_CONFIG);
+
+    sendFrame();
+}
+
+void setCANID() {           // Menu to configure CANID for each parameter 
+    u8g2.clearBuffer();
+
+    char buffer[50];
+    // Add bounds checking
+    size_t index = menuPos[1] + 4 * menuPos[0];
+    if (index < PARAM_COUNT && canManager.isDerived(index)) {     // No ID to set, show what it's computed from
+        u8g2.drawStr(4, 4, "Derived channel:");
+        u8g2.drawStr(4, 13, paramList[index]);
+        snprintf(buffer, sizeof(buffer), "= %s", paramDerived[index - PARAM_DERIVED_FIRST]);
+        u8g2.drawStr(4, 32, buffer);
+        sendFrame();
+        return;
+    }
+    if (index < PARAM_COUNT) {
+        u8g2.drawStr(4, 4, "Set CANBUS ID for:");
+        snprintf(buffer, sizeof(buffer), "%s", paramList[index]);
+        u8g2.drawStr(4, 13, buffer);
+    } else {
+        // Handle error - index out of bounds
+        u8g2.drawStr(9, 10, "Invalid Selection");
+    }
+
+    //u8g2.setFont(u8g2_font_ncenB14_tr);
+    //u8g2.setFont(u8g2_font_pfc_serif_v1_1_tf);
+    u8g2.setFont(u8g2_font_profont22_mf);
+    sprintf(buffer, "0x%03X", customCANID[index]);
+    u8g2.drawStr(64 - cachedStrWidth(u8g2_font_profont22_mf, buffer)/2, 32, buffer);
+    u8g2.setFont(u8g2_font_pfc_sans_v1_1_tf);   // CHANGE TO MONOSPACE FONT
+
+    int idWidth = cachedStrWidth(u8g2_font_pfc_sans_v1_1_tf, buffer);
+
+    // Multiplexed: only frames with this value in data[PARAM_MUX_BYTE]
+    if (customMux[index] == CAN_MUX_NONE) {
+        snprintf(buffer, sizeof(buffer), "Mux: off");
+    }
+    else {
+        snprintf(buffer, sizeof(buffer), "Mux: data[%d] = 0x%02X", PARAM_MUX_BYTE, customMux[index]);
+    }
+    u8g2.drawStr(4, 55, buffer);
+
+    if (digit == 3) {
+        u8g2.setDrawColor(2);
+        u8g2.drawBox(2, 54, cachedStrWidth(u8g2_font_pfc_sans_v1_1_tf, buffer) + 4, 9);
+    }
+    else if (digit != -1) {          // ERROR?
+        u8g2.setDrawColor(2);
+        u8g2.drawBox(95 - idWidth/2 - 12*digit, 34, 12, 16);        // Put at L, shift LEFT (-digit)
+        // EDIT AFTER FINDING MONOSPACE FONT
+    }
+
+    sendFrame();
+}
+
+void modeMenu() {
+    u8g2.clearBuffer();
+    u8g2.drawXBMP(0, 0, 128, 64, screen_2_etc_mode);
+
+    menuSelection(SCREEN_MODE);
+
+    sendFrame();
+}
+
+/************************* DATA SCREENS **************************/
+//                                   kind          slot  x    y   align        dp  font
+static const LayoutCell CHAN_1_CELLS[] = {
+    { CELL_VALUE,   0, 108, 18, ALIGN_RIGHT, -1, u8g2_font_timB24_tn },
+    { CELL_NAME_ID, 0,   1,  1, ALIGN_LEFT,  -1, u8g2_font_pfc_sans_v1_1_tf },
+    { CELL_UNIT,    0,  96, 56, ALIGN_LEFT,  -1, u8g2_font_pfc_sans_v1_1_tf },
+};
+
+#define CHAN_2_ROW(i) \
+    { CELL_NAME_ID, i,  1,  1 + 32 * i, ALIGN_LEFT,  -1, u8g2_font_pfc_sans_v1_1_tf }, \
+    { CELL_VALUE,   i, 70, 10 + 32 * i, ALIGN_RIGHT, -1, u8g2_font_ncenB14_tr }, \
+    { CELL_UNIT,    i, 80, 10 + 32 * i, ALIGN_LEFT,  -1, u8g2_font_ncenB14_tr }
+static const LayoutCell CHAN_2_CELLS[] = { CHAN_2_ROW(0), CHAN_2_ROW(1) };
+
+#define CHAN_4_ROW(i) \
+    { CELL_NAME,  i, 45, 3 + 16 * i, ALIGN_RIGHT, -1, u8g2_font_pfc_sans_v1_1_tf }, \
+    { CELL_VALUE, i, 95, 1 + 16 * i, ALIGN_RIGHT, -1, u8g2_font_bytesize_tr }, \
+    { CELL_UNIT,  i, 98, 1 + 16 * i, ALIGN_LEFT,  -1, u8g2_font_bytesize_tr }
+static const LayoutCell CHAN_4_CELLS[] = { CHAN_4_ROW(0), CHAN_4_ROW(1), CHAN_4_ROW(2), CHAN_4_ROW(3) };
+
+#define CHAN_8_ROW(i) \
+    { CELL_NAME,  i,  50, 8 * i, ALIGN_RIGHT, -1, u8g2_font_pfc_sans_v1_1_tf }, \
+    { CELL_VALUE, i, 100, 8 * i, ALIGN_RIGHT, -1, u8g2_font_pfc_sans_v1_1_tf }, \
+    { CELL_UNIT,  i, 103, 8 * i, ALIGN_LEFT,  -1, u8g2_font_pfc_sans_v1_1_tf }
+static const LayoutCell CHAN_8_CELLS[] = {
+    CHAN_8_ROW(0), CHAN_8_ROW(1), CHAN_8_ROW(2), CHAN_8_ROW(3),
+    CHAN_8_ROW(4), CHAN_8_ROW(5), CHAN_8_ROW(6), CHAN_8_ROW(7)
+};
+
+// Peak hold: "^max" next to each value, in place of the unit where there's no room
+static const LayoutCell CHAN_1_PEAK_CELLS[] = {
+    { CELL_VALUE,   0, 108, 18, ALIGN_RIGHT, -1, u8g2_font_timB24_tn },
+    { CELL_NAME_ID, 0,   1,  1, ALIGN_LEFT,  -1, u8g2_font_pfc_sans_v1_1_tf },
+    { CELL_UNIT,    0,  96, 56, ALIGN_LEFT,  -1, u8g2_font_pfc_sans_v1_1_tf },
+    { CELL_PEAK,    0,   1, 56, ALIGN_LEFT,  -1, u8g2_font_pfc_sans_v1_1_tf },
+};
+
+#define CHAN_2_PEAK_ROW(i) \
+    CHAN_2_ROW(i), \
+    { CELL_PEAK, i, 127, 25 + 32 * i, ALIGN_RIGHT, -1, u8g2_font_pfc_sans_v1_1_tf }
+static const LayoutCell CHAN_2_PEAK_CELLS[] = { CHAN_2_PEAK_ROW(0), CHAN_2_PEAK_ROW(1) };
+
+#define CHAN_4_PEAK_ROW(i) \
+    { CELL_NAME,  i,  45, 3 + 16 * i, ALIGN_RIGHT, -1, u8g2_font_pfc_sans_v1_1_tf }, \
+    { CELL_VALUE, i,  95, 1 + 16 * i, ALIGN_RIGHT, -1, u8g2_font_bytesize_tr }, \
+    { CELL_PEAK,  i, 127, 3 + 16 * i, ALIGN_RIGHT, -1, u8g2_font_pfc_sans_v1_1_tf }
+static const LayoutCell CHAN_4_PEAK_CELLS[] = { CHAN_4_PEAK_ROW(0), CHAN_4_PEAK_ROW(1), CHAN_4_PEAK_ROW(2), CHAN_4_PEAK_ROW(3) };
+
+#define CHAN_8_PEAK_ROW(i) \
+    { CELL_NAME,  i,  50, 8 * i, ALIGN_RIGHT, -1, u8g2_font_pfc_sans_v1_1_tf }, \
+    { CELL_VALUE, i, 100, 8 * i, ALIGN_RIGHT, -1, u8g2_font_pfc_sans_v1_1_tf }, \
+    { CELL_PEAK,  i, 127, 8 * i, ALIGN_RIGHT, -1, u8g2_font_pfc_sans_v1_1_tf }
+static const LayoutCell CHAN_8_PEAK_CELLS[] = {
+    CHAN_8_PEAK_ROW(0), CHAN_8_PEAK_ROW(1), CHAN_8_PEAK_ROW(2), CHAN_8_PEAK_ROW(3),
+    CHAN_8_PEAK_ROW(4), CHAN_8_PEAK_ROW(5), CHAN_8_PEAK_ROW(6), CHAN_8_PEAK_ROW(7)
+};
+
+#define LAYOUT(cells, slots) { cells, sizeof(cells) / sizeof(cells[0]), slots }
+static const ScreenLayout CHAN_1_LAYOUT = LAYOUT(CHAN_1_CELLS, 1);
+static const ScreenLayout CHAN_2_LAYOUT = LAYOUT(CHAN_2_CELLS, 2);
+static const ScreenLayout CHAN_4_LAYOUT = LAYOUT(CHAN_4_CELLS, 4);
+static const ScreenLayout CHAN_8_LAYOUT = LAYOUT(CHAN_8_CELLS, 8);
+static const ScreenLayout CHAN_1_PEAK_LAYOUT = LAYOUT(CHAN_1_PEAK_CELLS, 1);
+static const ScreenLayout CHAN_2_PEAK_LAYOUT = LAYOUT(CHAN_2_PEAK_CELLS, 2);
+static const ScreenLayout CHAN_4_PEAK_LAYOUT = LAYOUT(CHAN_4_PEAK_CELLS, 4);
+static const ScreenLayout CHAN_8_PEAK_LAYOUT = LAYOUT(CHAN_8_PEAK_CELLS, 8);
+
+static LayoutEngine dataLayout;
+
+static void drawDataScreen(const ScreenLayout& layout) {
+    dataLayout.draw(layout);            // Starts from the cached labels, no clearBuffer()
+    u8g2.setFont(u8g2_font_pfc_sans_v1_1_tf);       // Menus expect the default font back
+    sendFrame();
+}
+
+void chan_1() { drawDataScreen(peakHold ? CHAN_1_PEAK_LAYOUT : CHAN_1_LAYOUT); }
+void chan_2() { drawDataScreen(peakHold ? CHAN_2_PEAK_LAYOUT : CHAN_2_LAYOUT); }
+void chan_4() { drawDataScreen(peakHold ? CHAN_4_PEAK_LAYOUT : CHAN_4_LAYOUT); }
+void chan_8() { drawDataScreen(peakHold ? CHAN_8_PEAK_LAYOUT : CHAN_8_LAYOUT); }
+
+/************************* LAP TIMER **************************/
+
+// "m:ss.hh"
+static int formatLapTime(char* out, size_t size, uint32_t ms) {
+    uint32_t hundredths = ms / 10;
+    uint32_t seconds = hundredths / 100 % 60;
+    int n = formatScaled(out, size, hundredths / 6000, 0);
+    if (n + 7 > (int)size) return n;
+    out[n++] = ':';
+    out[n++] = '0' + seconds / 10;
+    out[n++] = '0' + seconds % 10;
+    out[n++] = '.';
+    out[n++] = '0' + hundredths % 100 / 10;
+    out[n++] = '0' + hundredths % 10;
+    out[n] = '\0';
+    return n;
+}
+
+// Lap number and sector on top, the predictive delta big in the middle,
+// running lap bottom left, best and last bottom right
+void lapScreen() {
+    char text[16];
+    u8g2.clearBuffer();
+    u8g2.setFont(u8g2_font_pfc_sans_v1_1_tf);
+
+    if (!lapStatus.running) {
+        u8g2.drawStr(1, 1, "LAP TIMER");
+        u8g2.drawStr(1, 20, "NEXT at the line");
+        u8g2.drawStr(1, 30, "to start");
+        sendFrame();
+        return;
+    }
+
+    formatScaled(text, sizeof(text), lapStatus.lap + 1, 0);
+    u8g2.drawStr(1, 1, "LAP");
+    u8g2.drawStr(20, 1, text);
+    if (lapStatus.sectors > 1) {
+        text[0] = 'S';
+        formatScaled(text + 1, sizeof(text) - 1, lapStatus.sector + 1, 0);
+        u8g2.drawStr(127 - cachedStrWidth(u8g2_font_pfc_sans_v1_1_tf, text), 1, text);
+    }
+
+    // +/- seconds against the best lap, hundredths
+    u8g2.setFont(u8g2_font_timB24_tn);
+    if (lapStatus.deltaValid) {
+        int32_t delta = lapStatus.deltaMs / 10;
+        if (delta > 9999) delta = 9999;
+        if (delta < -9999) delta = -9999;
+        text[0] = '+';
+        formatScaled(delta >= 0 ? text + 1 : text, sizeof(text) - 1, delta, 2);
+    }
+    else {
+        strcpy(text, "-.--");
+    }
+    u8g2.drawStr((128 - cachedStrWidth(u8g2_font_timB24_tn, text)) / 2, 12, text);
+
+    u8g2.setFont(u8g2_font_ncenB14_tr);
+    formatLapTime(text, sizeof(text), lapStatus.currentLapMs(halMicros()));
+    u8g2.drawStr(1, 44, text);
+
+    u8g2.setFont(u8g2_font_pfc_sans_v1_1_tf);
+    if (lapStatus.bestLapMs) {
+        formatLapTime(text, sizeof(text), lapStatus.bestLapMs);
+        u8g2.drawStr(80, 42, "B");
+        u8g2.drawStr(127 - cachedStrWidth(u8g2_font_pfc_sans_v1_1_tf, text), 42, text);
+    }
+    if (lapStatus.lastLapMs) {
+        formatLapTime(text, sizeof(text), lapStatus.lastLapMs);
+        u8g2.drawStr(80, 53, "L");
+        u8g2.drawStr(127 - cachedStrWidth(u8g2_font_pfc_sans_v1_1_tf, text), 53, text);
+    }
+    sendFrame();
+}
+
+/************************* GRAPH **************************/
+
+#define GRAPH_TOP 10                    // Below the title line
+#define GRAPH_BOTTOM 63
+
+static int graphChannel = 0;            // paramList[] index
+static int graphLevel = 0;              // ChannelHistory level, 16 s / 64 s / 256 s across
+
+// One channel's last 16 s to 4 min, one history column per pixel with its min to max
+// drawn as a vertical line, scaled to what's on screen. O(HISTORY_COLUMNS) per frame.
+void graphScreen() {
+    static HistoryColumn columns[HISTORY_COLUMNS];
+    char text[20];
+    u8g2.clearBuffer();
+    u8g2.setFont(u8g2_font_pfc_sans_v1_1_tf);
+
+    int channel = graphChannel;
+    int precision = paramPrecision[channel];
+    uint8_t decimals = canSnapshot.decimals[channel];
+    canManager.readHistory(channel, graphLevel, columns);
+
+    u8g2.drawStr(1, 1, paramList[channel]);
+    int n = formatScaled(text, sizeof(text), ChannelHistory::columnMs(graphLevel) * HISTORY_COLUMNS / 1000, 0);
+    snprintf(text + n, sizeof(text) - n, "s");
+    u8g2.drawStr(127 - u8g2.getStrWidth(text), 1, text);
+    if (canSnapshot.isFresh(channel)) {
+        formatScaled(text, sizeof(text), rescaleFixed(canSnapshot.values[channel].value, decimals, precision), precision);
+    }
+    else {
+        strcpy(text, "---");
+    }
+    u8g2.drawStr(50, 1, text);
+    u8g2.drawStr(52 + cachedStrWidth(u8g2_font_pfc_sans_v1_1_tf, text), 1, paramUnits[channel]);
+
+    int32_t low = INT32_MAX, high = INT32_MIN;
+    for (int x = 0; x < HISTORY_COLUMNS; x++) {
+        if (columns[x].empty()) continue;
+        if (columns[x].min < low) low = columns[x].min;
+        if (columns[x].max > high) high = columns[x].max;
+    }
+    if (low > high) {
+        u8g2.drawStr(40, 32, "No data");
+        sendFrame();
+        return;
+    }
+    if (high == low) {                  // Flat line through the middle
+        high++;
+        low--;
+    }
+
+    const int64_t span = (int64_t)high - low;
+    const int height = GRAPH_BOTTOM - GRAPH_TOP;
+    for (int x = 0; x < HISTORY_COLUMNS; x++) {
+        if (columns[x].empty()) continue;
+        int top = GRAPH_BOTTOM - (int)(((int64_t)columns[x].max - low) * height / span);
+        int bottom = GRAPH_BOTTOM - (int)(((int64_t)columns[x].min - low) * height / span);
+        u8g2.drawVLine(x, top, bottom - top + 1);
+    }
+
+    // Scale top left and bottom left, on a cleared patch so the trace doesn't run through them
+    const int32_t labels[] = {high, low};
+    const int labelY[] = {GRAPH_TOP, GRAPH_BOTTOM - 7};
+    for (int i = 0; i < 2; i++) {
+        formatScaled(text, sizeof(text), rescaleFixed(labels[i], decimals, precision), precision);
+        u8g2.setDrawColor(0);
+        u8g2.drawBox(0, labelY[i], cachedStrWidth(u8g2_font_pfc_sans_v1_1_tf, text) + 1, 8);
+        u8g2.setDrawColor(1);
+        u8g2.drawStr(0, labelY[i], text);
+    }
+    sendFrame();
+}
+
+/************************* ALARMS **************************/
+
+// Level, name and live value, big and centered, the whole screen inverting on and off.
+// The level is the latched one, the alarm may already be over, so the worst value goes below
+void alarmScreen(int channel) {
+    char text[20];
+    AlarmLevel level = alarmStatus.latched[channel];
+    uint32_t flashMs = level == ALARM_CRITICAL ? ALARM_FLASH_MS : 2 * ALARM_FLASH_MS;
+    bool inverted = (halMillis() / flashMs) & 1;
+    int precision = paramPrecision[channel];
+    uint8_t decimals = canSnapshot.decimals[channel];
+
+    u8g2.clearBuffer();
+    if (inverted) {
+        u8g2.drawBox(0, 0, 128, 64);
+        u8g2.setDrawColor(0);
+    }
+    u8g2.setFont(u8g2_font_ncenB14_tr);
+    const char* title = level == ALARM_CRITICAL ? "CRITICAL" : "WARNING";
+    u8g2.drawStr((128 - u8g2.getStrWidth(title)) / 2, 2, title);
+    u8g2.drawStr((128 - u8g2.getStrWidth(paramList[channel])) / 2, 19, paramList[channel]);
+
+    int n;
+    if (canSnapshot.isFresh(channel)) {
+        n = formatScaled(text, sizeof(text), rescaleFixed(canSnapshot.values[channel].value, decimals, precision), precision);
+    }
+    else {
+        n = snprintf(text, sizeof(text), "---");
+    }
+    snprintf(text + n, sizeof(text) - n, " %s", paramUnits[channel]);
+    u8g2.drawStr((128 - u8g2.getStrWidth(text)) / 2, 36, text);
+
+    u8g2.setFont(u8g2_font_pfc_sans_v1_1_tf);
+    n = snprintf(text, sizeof(text), "worst ");
+    formatScaled(text + n, sizeof(text) - n, rescaleFixed(alarmStatus.worst[channel], decimals, precision), precision);
+    u8g2.drawStr((128 - u8g2.getStrWidth(text)) / 2, 55, text);
+
+    u8g2.setDrawColor(1);
+    sendFrame();
+}
+
+/************************* INPUT **************************/
+
+static void dataScreenInput(uint8_t pin) {
+    if (pin == RIGHT_SW) {
+        enterScreen(SCREEN_LAP, false);
+    }
+    if (pin == LEFT_SW) {
+        int channel = selectedCANID[0];
+        graphChannel = channel >= 0 && channel < PARAM_COUNT ? channel : 0;   // Starts on what the screen showed first
+        enterScreen(SCREEN_GRAPH, false);
+    }
+}
+
+static void dataScreenNext() {
+    peakHold = !peakHold;
+    overlay.toast({peakHold ? "Peak Hold 10s" : "Peak Hold Off", u8g2_font_pfc_sans_v1_1_tf}, 1000, halMillis());
+}
+
+static void lapScreenInput(uint8_t pin) {
+    if (pin == DOWN_SW) {
+        lapTimer.reset();
+        overlay.toast({"Laps Reset", u8g2_font_pfc_sans_v1_1_tf}, 1000, halMillis());
+    }
+}
+
+static void graphScreenInput(uint8_t pin) {
+    if (pin == UP_SW) graphChannel = mod(graphChannel - 1, PARAM_COUNT);
+    if (pin == DOWN_SW) graphChannel = mod(graphChannel + 1, PARAM_COUNT);
+}
+
+static void graphScreenNext() {
+    graphLevel = (graphLevel + 1) % HISTORY_LEVELS;
+}
+
+static void lapScreenNext() {
+    lapTimer.trigger();                 // Start/finish line
+}
+
+static void canIDConfigInput(uint8_t pin) {
+    if (pin == UP_SW) {
+        menuPos[1] = mod(menuPos[1] - 1, 4);
+        if(menuPos[1] == 3) {
+            menuPos[0] = mod(menuPos[0] - 1, PARAM_COUNT / 4);   // Column 2 = the derived page
+        }
+    }
+    if (pin == DOWN_SW) {
+        menuPos[1] = mod(menuPos[1] + 1, 4);
+        if(menuPos[1] == 0) {
+            menuPos[0] = mod(menuPos[0] + 1, PARAM_COUNT / 4);
+        }
+    }
+
+    if (pin == LEFT_SW) {               // this shit needs to REMEMBER LOL ya glhf gn EDIT FIXED LFGGG
+        if (paramCursor == 8) { 
+            paramCursor = 0; 
+            memset(selectedCANID, -1, sizeof(selectedCANID));    // clear array
+        }
+        size_t index = menuPos[1] + 4 * menuPos[0];
+        if (selectedCANID[paramCursor] == -1) {
+            selectedCANID[paramCursor] = index;
+            paramLocation[paramCursor][0] = menuPos[0];         // Store X location
+            paramLocation[paramCursor][1] = menuPos[1];         // Store Y location
+            paramCursor++;
+        }
+    }
+    if (pin == RIGHT_SW) {
+        enterScreen(SCREEN_SET_CANID, false);
+    }
+}
+
+static void setCANIDInput(uint8_t pin) {
+    size_t index = menuPos[1] + 4 * menuPos[0];
+    if (index >= PARAM_COUNT || canManager.isDerived(index)) return;      // Nothing to edit
+
+    // If left, do MSD (M)
+    // If right, do LSD (L)
+    // 0xMmL, then the mux value
+    if (pin == LEFT_SW) { 
+        digit = mod(digit + 1, 4); 
+    }
+    else if (pin == RIGHT_SW) { 
+        digit = mod(digit - 1, 4); 
+    }
+
+    if (digit == 3) {                   // 0xFE, off, 0x00, 0x01... CAN_MUX_NONE is 0xFF
+        if (pin == UP_SW) customMux[index]++;
+        if (pin == DOWN_SW) customMux[index]--;
+    }
+    else if (digit != -1) {          // ERROR?
+        if (pin == UP_SW) {
+            customCANID[index] = customCANID[index] + (0x001 << (digit*4));         // damn << has lower precedence than +
+        }
+        if (pin == DOWN_SW) {
+            customCANID[index] = customCANID[index] - (0x001 << (digit*4));
+        }
+
+        customCANID[index] = customCANID[index] & 0x7FF;    // Bitmask to 11 bit for standard CAN 2.0A
+    }
+}
+
+static void canIDConfigEnter() {
+    loadCANIDS();
+    paramCursor = 8;
+}
+
+static void setCANIDEnter() {
+    digit = 1;
+}
+
+static void canIDConfigNext() {
+    if (paramCursor == 8) {
+        saveCANIDS();
+#ifndef CAN_SIGNAL_TABLE
+        for (int i = 0; i < sizeof(customCANID) / sizeof(customCANID[0]); i++) {
+            canManager.setCustomID(i, customCANID[i], paramMux(i));   // Load CANIDs into canManager
+        }
+        canManager.stopIngestTask();    // canSetup() deletes the TWAI queue the task blocks on
+        canSetup();                     // Re-apply the hardware filter for the new IDs
+        canManager.startIngestTask(0);
+#endif
+        overlay.toast({"CAN IDs", u8g2_font_pfc_sans_v1_1_tf}, {"Saved!", u8g2_font_ncenB14_tr}, 500, halMillis());
+        enterScreen(SCREEN_MAIN, true);
+    }
+    else {
+        // DONT saveCANIDS
+        overlay.toast({"Please Select 8", u8g2_font_pfc_sans_v1_1_tf}, {"Parameters!", u8g2_font_pfc_sans_v1_1_tf}, 1500, halMillis());
+    }
+}
+
+static void setCANIDNext() {
+    enterScreen(SCREEN_CANID_CONFIG, false);
+}
+
+static void modeMenuNext() {
+    if (menuPos[1] == 2) {              // AUTOSLEEP TOGGLE
+        AUTOSLEEP = !AUTOSLEEP;
+        overlay.toast({"AUTO Sleep Set To:", u8g2_font_pfc_sans_v1_1_tf}, {AUTOSLEEP ? "ON" : "OFF", u8g2_font_ncenB14_tr}, 1500, halMillis());
+        enterScreen(SCREEN_MAIN, true);
+    }
+}
+
+/************************* MENU TABLE **************************/
+
+// What each screen draws and where its buttons lead. UP/DOWN move the cursor over `rows`
+// unless the screen has its own input, NEXT opens items[cursor] unless it has its own next,
+// PREV goes to prev.
+struct MenuScreen {
+    ScreenId id;
+    void (*draw)();
+    void (*input)(uint8_t pin);         // UP/DOWN/LEFT/RIGHT, nullptr = cursor over rows
+    void (*next)();                     // NEXT, nullptr = open items[menuPos[1]]
+    void (*enter)();                    // When opened from its prev screen, nullptr = nothing
+    const ScreenId* items;
+    uint8_t rows;                       // Cursor rows, also: entering the screen starts at the top
+    ScreenId prev;
+    bool prevResets;                    // PREV puts the cursor back to the top
+    uint8_t channels;                   // Data channels shown, for screenSignature()
+};
+
+static const ScreenId MAIN_ITEMS[] = {SCREEN_CHANNEL_SELECT, SCREEN_CANID_CONFIG, SCREEN_MODE};
+static const ScreenId CHANNEL_ITEMS[] = {SCREEN_CHAN_1, SCREEN_CHAN_2, SCREEN_CHAN_4, SCREEN_CHAN_8};
+
+static const MenuScreen MENU_SCREENS[] = {
+//    id                     draw          input             next             enter              items          rows  prev                   resets  channels
+    { SCREEN_MAIN,           mainMenu,     nullptr,          nullptr,         nullptr,           MAIN_ITEMS,    3,    SCREEN_MAIN,           true,   0 },
+    { SCREEN_CHANNEL_SELECT, chanSelect,   nullptr,          nullptr,         nullptr,           CHANNEL_ITEMS, 4,    SCREEN_MAIN,           true,   0 },
+    { SCREEN_CHAN_1,         chan_1,       dataScreenInput,  dataScreenNext,  nullptr,           nullptr,       0,    SCREEN_CHANNEL_SELECT, false,  1 },
+    { SCREEN_CHAN_2,         chan_2,       dataScreenInput,  dataScreenNext,  nullptr,           nullptr,       0,    SCREEN_CHANNEL_SELECT, false,  2 },
+    { SCREEN_CHAN_4,         chan_4,       dataScreenInput,  dataScreenNext,  nullptr,           nullptr,       0,    SCREEN_CHANNEL_SELECT, false,  4 },
+    { SCREEN_CHAN_8,         chan_8,       dataScreenInput,  dataScreenNext,  nullptr,           nullptr,       0,    SCREEN_CHANNEL_SELECT, false,  8 },
+    { SCREEN_LAP,            lapScreen,    lapScreenInput,   lapScreenNext,   nullptr,           nullptr,       0,    SCREEN_CHANNEL_SELECT, false,  0 },
+    { SCREEN_GRAPH,          graphScreen,  graphScreenInput, graphScreenNext, nullptr,           nullptr,       0,    SCREEN_CHANNEL_SELECT, false,  0 },
+    { SCREEN_CANID_CONFIG,   canID_config, canIDConfigInput, canIDConfigNext, canIDConfigEnter,  nullptr,       4,    SCREEN_MAIN,           true,   0 },
+    { SCREEN_SET_CANID,      setCANID,     setCANIDInput,    setCANIDNext,    setCANIDEnter,     nullptr,       0,    SCREEN_CANID_CONFIG,   false,  0 },
+    { SCREEN_MODE,           modeMenu,     nullptr,          modeMenuNext,    nullptr,           nullptr,       3,    SCREEN_MAIN,           true,   0 },
+};
+
+static const MenuScreen* findScreen(int id) {
+    for (const MenuScreen& screen : MENU_SCREENS) {
+        if (screen.id == id) return &screen;
+    }
+    return nullptr;
+}
+
+void enterScreen(ScreenId id, bool resetCursor) {
+    const MenuScreen* screen = findScreen(id);
+    if (screen == nullptr) return;
+    bool fromParent = screen->prev == menuPos[2];
+    if (resetCursor) {
+        menuPos[0] = 0;
+        menuPos[1] = 0;
+    }
+    menuPos[2] = id;
+    if (screen->enter && fromParent) screen->enter();   // Not when coming back from a child screen
+}
+
+// One button press (or auto-repeat) on the current screen. Drawing doesn't read buttons
+static void menuInput(uint8_t pin) {
+    const MenuScreen* screen = findScreen(menuPos[2]);
+    if (screen == nullptr) {
+        enterScreen(SCREEN_MAIN, true);
+        return;
+    }
+
+    if (pin == NEXT_SW) {
+        if (screen->next) {
+            screen->next();
+        }
+        else if (screen->items && menuPos[1] >= 0 && menuPos[1] < screen->rows) {
+            ScreenId target = screen->items[menuPos[1]];
+            const MenuScreen* opened = findScreen(target);
+            enterScreen(target, opened && opened->rows > 0);    // Menus start at the top, data screens keep the cursor for PREV
+        }
+    }
+    else if (pin == PREV_SW) {
+        enterScreen(screen->prev, screen->prevResets);
+    }
+    else if (screen->input) {
+        screen->input(pin);
+    }
+    else if (screen->rows > 0) {
+        if (pin == UP_SW) menuPos[1] = mod(menuPos[1] - 1, screen->rows);
+        if (pin == DOWN_SW) menuPos[1] = mod(menuPos[1] + 1, screen->rows);
+    }
+}
+
+// FNV-1a over everything the current screen draws from, equal signature = identical frame
+static uint32_t screenSignature(const MenuScreen* screen, uint32_t nowMs) {
+    uint32_t h = 2166136261u;
+    auto mix = [&h](uint32_t v) {
+        for (int i = 0; i < 4; i++, v >>= 8) {
+            h = (h ^ (v & 0xFF)) * 16777619u;
+        }
+    };
+    mix(menuPos[0]);
+    mix(menuPos[1]);
+    mix(menuPos[2]);
+    mix(digit);
+    mix(paramCursor);
+    mix(overlay.visible(nowMs));        // Redraw without it once it expires
+    mix(alarmStatus.version);
+    mix(alarmStatus.active);
+    mix(alarmStatus.unacknowledged);
+    int alarm = alarmStatus.shown();
+    if (alarm >= 0) {                   // The alarm screen is up instead
+        mix(nowMs / (alarmStatus.latched[alarm] == ALARM_CRITICAL ? ALARM_FLASH_MS : 2 * ALARM_FLASH_MS));
+        mix(canSnapshot.seq(alarm));
+        mix(canSnapshot.isFresh(alarm));
+        return h;
+    }
+    if (screen && screen->id == SCREEN_LAP) {
+        mix(lapStatus.version);
+        mix(lapStatus.currentLapMs(halMicros()) / 10);   // The clock shows hundredths
+    }
+    if (screen && screen->id == SCREEN_GRAPH) {
+        mix(graphChannel);
+        mix(graphLevel);
+        mix(canSnapshot.seq(graphChannel));
+        mix(canSnapshot.isFresh(graphChannel));
+        mix(nowMs / ChannelHistory::columnMs(graphLevel));   // Scrolls a column at a time
+    }
+    int channels = screen ? screen->channels : 0;
+    for (int i = 0; i < channels; i++) {
+        int channel = selectedCANID[i];
+        mix(canSnapshot.seq(channel));
+        mix(canSnapshot.isFresh(channel));
+        if (peakHold && channel >= 0 && channel < MAX_CHANNELS) {
+            mix(canStats.channels[channel].windowMax[PEAK_HOLD_WINDOW]);   // Falls as old peaks leave the window
+        }
+    }
+    return h;
+}
+
+void doMenus() {
+    uint32_t now = halMillis();
+    alarms.status(alarmStatus);
+    buttons.poll(now);
+    ButtonEvent event;
+    while (buttons.next(event)) {
+        if (event.action == BUTTON_PRESS && alarmStatus.shown() >= 0) {
+            alarms.acknowledge(alarmStatus.unacknowledged);     // Any button clears the alarm screen, the "!" stays
+            alarms.status(alarmStatus);
+            renderScheduler.invalidate();
+            continue;
+        }
+        if (event.action == BUTTON_PRESS && overlay.isSplash()) {
+            overlay.dismiss();              // A press skips the boot logo, it doesn't act on the hidden menu
+            renderScheduler.invalidate();
+            continue;
+        }
+        // Presses, and auto-repeat for the buttons that step through things
+        bool stepping = event.pin == UP_SW || event.pin == DOWN_SW;
+        if (event.action == BUTTON_PRESS || (event.action == BUTTON_REPEAT && stepping)) {
+            menuInput(event.pin);
+            renderScheduler.invalidate();   // Not everything input changes is in the signature (customCANID)
+        }
+    }
+
+    // One consistent copy for the signature and every screen, with the stats only when shown
+    if (peakHold) {
+        canManager.snapshot(canSnapshot, canStats);
+    }
+    else {
+        canManager.snapshot(canSnapshot);
+    }
+    uint16_t lapsBefore = lapStatus.lap;
+    lapTimer.status(lapStatus);
+    if (lapStatus.lap > lapsBefore && lapStatus.lastLapMs) {
+        static char lapText[16];        // Has to outlive the toast
+        formatLapTime(lapText, sizeof(lapText), lapStatus.lastLapMs);
+        overlay.toast({lapStatus.lastLapMs == lapStatus.bestLapMs ? "BEST LAP" : "LAP", u8g2_font_pfc_sans_v1_1_tf},
+                      {lapText, u8g2_font_ncenB14_tr}, 2000, now);
+    }
+
+    // A new alarm goes out right away, not at the next render slot
+    static uint32_t alarmRaisesDrawn = 0;
+    int alarm = alarmStatus.shown();
+    bool urgent = alarm >= 0 && alarmStatus.raises != alarmRaisesDrawn;
+    if (urgent && overlay.isSplash()) overlay.dismiss();
+
+    const MenuScreen* screen = findScreen(menuPos[2]);
+    if (urgent || renderScheduler.shouldRender(screenSignature(screen, now), now)) {
+        if (alarm >= 0) {
+            alarmScreen(alarm);
+        }
+        else if (screen) {
+            screen->draw();             // Overlay goes on top in sendFrame()
+        }
+        alarmRaisesDrawn = alarmStatus.raises;
+        renderScheduler.rendered(screenSignature(screen, now), now);
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "Hal.h"
+#include <U8g2lib.h>
+#include "CanbusCommander.h"
+#include "CANDataManager.h"
+#include "FramebufferSink.h"
+#include "KeyValueStore.h"
+#include "RenderScheduler.h"
+#include "ButtonEvents.h"
+#include "Overlay.h"
+#include "LapTimer.h"
+#include "AlarmEngine.h"
+
+#define PARAM_COUNT 12                  // paramList[] entries, canManager channels 0 to 11
+#define PARAM_DERIVED_FIRST 8           // From here on computed from paramDerived[], no CAN ID
+#define PARAM_MUX_BYTE 0                // Where the ECU puts the mux value of multiplexed frames (0x180: 10 or 11)
+#define LAP_SPEED_CHANNEL 3             // paramList[3], "Speed" in km/h
+#define PEAK_HOLD_WINDOW STATS_10S      // What the peak-hold overlay on the data screens shows
+#define ALARM_FLASH_MS 250              // Critical alarm screen inverts this often, warnings at half the rate
+
+// Provided by the platform main (main.cpp on the ESP32, native/main_native.cpp on the host)
+extern U8G2_KS0108_128X64_F u8g2;
+extern CANDataManager canManager;
+extern KeyValueStore& preferences;
+void canSetup();                        // (Re)start the CAN source with the current IDs
+
+// screens.cpp
+extern bool AUTOSLEEP;
+extern FramebufferSink* frameSink;      // Where sendFrame() puts finished frames
+extern RenderScheduler renderScheduler; // When doMenus() redraws
+extern ChannelSnapshot canSnapshot;     // Channel values for this doMenus() pass
+extern ChannelStatsSnapshot canStats;   // Their stats, only refreshed while peakHold is on
+extern bool peakHold;                   // Data screens show the PEAK_HOLD_WINDOW maximum, NEXT toggles
+extern ButtonEvents buttons;            // Debounced front panel input, doMenus() consumes it
+extern Overlay overlay;                 // Toasts and the boot logo, drawn over the current screen
+extern LapTimer lapTimer;               // Fed by canManager as a ChannelListener (main sets that up)
+extern LapStatus lapStatus;             // Lap state for this doMenus() pass
+extern AlarmEngine alarms;              // Also a ChannelListener, rules from paramAlarms[]
+extern AlarmStatus alarmStatus;         // Alarm state for this doMenus() pass
+extern int menuPos[3];                  // Cursor column, cursor row, ScreenId
+extern const char * paramList[PARAM_COUNT];
+extern const char * paramUnits[PARAM_COUNT];
+extern const int8_t paramPrecision[PARAM_COUNT];
+extern const AlarmRule paramAlarms[PARAM_COUNT];
+extern const char * paramDerived[PARAM_COUNT - PARAM_DERIVED_FIRST];
+extern uint16_t customCANID[12];
+extern uint8_t customMux[12];           // CAN_MUX_NONE = every frame of the ID
+extern int selectedCANID[8];
+
+// Values of menuPos[2]
+enum ScreenId : uint8_t {
+    SCREEN_MAIN = 0,
+    SCREEN_CHANNEL_SELECT = 10,
+    SCREEN_CHAN_1 = 11,
+    SCREEN_CHAN_2 = 12,
+    SCREEN_CHAN_4 = 13,
+    SCREEN_CHAN_8 = 14,
+    SCREEN_LAP = 15,                    // RIGHT from a data screen
+    SCREEN_GRAPH = 16,                  // LEFT from a data screen
+    SCREEN_CANID_CONFIG = 20,
+    SCREEN_SET_CANID = 21,
+    SCREEN_MODE = 30,
+};
+
+void saveCANIDS();
+void loadCANIDS();
+CANMux paramMux(int param);             // customMux[param] as setCustomID() takes it
+void derivedSetup();                    // Compiles paramDerived[] into canManager, after canManager.begin()
+void u8g2_prepare(void);
+void sendFrame();
+void showBootScreen(uint32_t durationMs);   // Boot logo over the first frames, a press skips it
+void resetDroplets();
+bool getSW(int SW);                     // Raw level, for the test screens. Menus use buttons
+
+void buttonTest();
+void cupTest();
+void mainMenu();
+void chanSelect();
+void canID_config();
+void setCANID();
+void modeMenu();
+void chan_1();
+void chan_2();
+void chan_4();
+void chan_8();
+void lapScreen();
+void graphScreen();
+void alarmScreen(int channel);          // Full screen, drawn instead of the current one while an alarm is unacknowledged
+void enterScreen(ScreenId id, bool resetCursor);   // Runs the screen's enter hook when coming from its parent
+void doMenus();                        // Handles queued button events, then draws the current screen if something changed
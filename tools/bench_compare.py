@@ -0,0 +1,75 @@
+"""
+Compare two benchmark runs (JSON lines from src/bench) and flag regressions.
+
+    python tools/bench_compare.py baseline.jsonl current.jsonl [--threshold 10]
+
+Exits 1 if any metric got worse by more than the threshold (percent).
+Non-JSON lines (boot messages on the serial port) are ignored.
+"""
+
+import json
+import sys
+
+# Metric -> True if higher is better
+METRICS = {
+    "frames_per_s": True,
+    "eval_ns": False,
+    "snapshot_ns": False,
+    "stats_snapshot_ns": False,
+    "fixed_ns": False,
+    "compose_us": False,
+    "present_us": False,
+    "present_bytes": False,
+    "mean_us": False,
+    "p95_us": False,
+    "rate_hz": True,
+    "bytes_per_s": False,
+    "flush_mean_us": False,
+    "max_update_us": False,
+}
+
+
+def load(path):
+    results = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith("{"):
+                continue
+            try:
+                r = json.loads(line)
+            except ValueError:
+                continue
+            key = (r.get("bench"), r.get("format", r.get("refresh_hz", r.get("channels", r.get("screen", r.get("decimals"))))))
+            results[key] = r
+    return results
+
+
+def main(argv):
+    import argparse
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("baseline")
+    ap.add_argument("current")
+    ap.add_argument("--threshold", type=float, default=10.0)
+    args = ap.parse_args(argv)
+
+    base = load(args.baseline)
+    cur = load(args.current)
+    worse = 0
+    for key in sorted(set(base) & set(cur), key=str):
+        for metric, higher_better in METRICS.items():
+            if metric not in base[key] or metric not in cur[key]:
+                continue
+            old, new = float(base[key][metric]), float(cur[key][metric])
+            if old == 0:
+                continue
+            change = (new - old) / old * 100
+            regressed = -change > args.threshold if higher_better else change > args.threshold
+            worse += regressed
+            print("%-8s %-14s %-14s %12.1f -> %12.1f  %+6.1f%%%s"
+                  % (key[0], key[1], metric, old, new, change, "  REGRESSION" if regressed else ""))
+    return 1 if worse else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,255 @@
+"""
+DBC -> C++ signal table for CANDataManager.
+
+Parses the BO_/SG_ lines of a DBC file and writes a header with
+  DBC_SIGNALS[]   one CANSignalDef per signal (channel index = array index)
+  DBC_DISPATCH[]  perfect hash of message ID -> channel bitmask, found offline
+  DBC_MUX_DISPATCH[]  the same for (ID, mux value) of multiplexed messages, if there are any
+  dbcChannels()   the constant time lookup CANDataManager uses instead of CANDispatch
+
+Multiplexed messages need their selector (M) to be one whole byte; its mN signals become
+channels that only decode from frames with that byte = N. The selector itself isn't a channel.
+
+Standalone:
+    python tools/dbc_import.py ecu.dbc -o include/dbc_signals.h
+
+PlatformIO (pre: extra script), runs when the env sets custom_dbc_file:
+    extra_scripts = pre:tools/dbc_import.py
+    custom_dbc_file = dbc/ecu.dbc
+"""
+
+import os
+import random
+import re
+import sys
+
+BO_RE = re.compile(r"^BO_\s+(\d+)\s+(\w+)\s*:\s*(\d+)\s+(\w+)")
+SG_RE = re.compile(
+    r"^\s*SG_\s+(\w+)\s*(M|m\d+)?\s*:\s*(\d+)\|(\d+)@([01])([+-])\s*"
+    r"\(\s*([^,]+),\s*([^)]+)\)\s*\[[^\]]*\]\s*\"([^\"]*)\""
+)
+
+CAN_EFF_FLAG = 0x80000000
+EMPTY_ID = 0xFFFFFFFF
+
+
+class Signal:
+    def __init__(self, msg_id, name, start, length, intel, signed, scale, offset, unit, mux):
+        self.msg_id = msg_id
+        self.name = name
+        self.start = start
+        self.length = length
+        self.intel = intel
+        self.signed = signed
+        self.scale = scale
+        self.offset = offset
+        self.unit = unit
+        self.mux = mux          # None, "M" (selector) or "mN" (multiplexed on value N)
+
+
+def parse_dbc(path):
+    signals = []
+    msg_id = None
+    with open(path, encoding="latin-1") as f:
+        for line in f:
+            m = BO_RE.match(line)
+            if m:
+                raw = int(m.group(1))
+                msg_id = raw & 0x1FFFFFFF if raw & CAN_EFF_FLAG else raw
+                continue
+            m = SG_RE.match(line)
+            if m and msg_id is not None:
+                name, mux, start, length, order, sign, scale, offset, unit = m.groups()
+                signals.append(Signal(msg_id, name, int(start), int(length), order == "1",
+                                      sign == "-", float(scale), float(offset), unit, mux))
+            elif not line.strip():
+                msg_id = None
+    return signals
+
+
+def mux_bytes(signals, warn):
+    """Message ID -> payload byte of its selector, for the messages whose selector fits CANMux."""
+    found = {}
+    for sig in signals:
+        if sig.mux != "M":
+            continue
+        aligned = sig.start % 8 == (0 if sig.intel else 7)
+        if sig.length != 8 or not aligned:
+            warn("%s: mux selector isn't a whole byte, its multiplexed signals are skipped" % sig.name)
+            continue
+        found[sig.msg_id] = sig.start // 8
+    return found
+
+
+def usable(sig, mux_byte, warn):
+    if sig.length > 32:
+        warn("%s: %d bit signals not supported, skipped" % (sig.name, sig.length))
+        return False
+    if sig.mux == "M":
+        return False            # Only says which signals a frame has, see mux_bytes()
+    if sig.mux is not None:
+        if sig.msg_id not in mux_byte:
+            return False
+        if int(sig.mux[1:]) > 255:
+            warn("%s: mux value %s doesn't fit a byte, skipped" % (sig.name, sig.mux[1:]))
+            return False
+    return True
+
+
+def perfect_hash(keys, width=32):
+    """Smallest power of two table + odd multiplier with no collisions, slot = (key * mul) >> shift."""
+    rng = random.Random(0x5EED)
+    full = (1 << width) - 1
+    bits = max(1, (len(keys) - 1).bit_length())
+    while bits <= 12:
+        for _ in range(20000):
+            mul = rng.getrandbits(width) | 1
+            slots = {((k * mul) & full) >> (width - bits) for k in keys}
+            if len(slots) == len(keys):
+                return mul, bits
+        bits += 1
+    raise RuntimeError("no perfect hash found for %d keys" % len(keys))
+
+
+def c_string(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def c_float(v):
+    s = repr(float(v))
+    return (s if ("." in s or "e" in s) else s + ".0") + "f"
+
+
+def generate(dbc_path, out_path, warn=lambda m: sys.stderr.write("dbc_import: " + m + "\n")):
+    parsed = parse_dbc(dbc_path)
+    mux_byte = mux_bytes(parsed, warn)
+    signals = [s for s in parsed if usable(s, mux_byte, warn)]
+    if not signals:
+        raise RuntimeError("no usable signals in " + dbc_path)
+    if len(signals) > 64:
+        warn("%d signals, only the first 64 fit a ChannelMask" % len(signals))
+        signals = signals[:64]
+
+    masks = {}
+    mux_masks = {}              # (ID << 8) | mux value -> channels
+    for ch, sig in enumerate(signals):
+        masks[sig.msg_id] = masks.get(sig.msg_id, 0)
+        if sig.mux is None:
+            masks[sig.msg_id] |= 1 << ch
+        else:
+            key = sig.msg_id << 8 | int(sig.mux[1:])
+            mux_masks[key] = mux_masks.get(key, 0) | (1 << ch)
+    ids = sorted(masks)
+    mul, bits = perfect_hash(ids)
+    table = [None] * (1 << bits)
+    for i in ids:
+        table[((i * mul) & 0xFFFFFFFF) >> (32 - bits)] = i
+
+    out = []
+    out.append("// Generated by tools/dbc_import.py from %s, do not edit by hand" % os.path.basename(dbc_path))
+    out.append("#pragma once")
+    out.append('#include "CANSignal.h"')
+    out.append('#include "CANDispatch.h"')
+    out.append("")
+    out.append("#define DBC_SIGNAL_COUNT %d" % len(signals))
+    out.append("#define DBC_MESSAGE_COUNT %d" % len(ids))
+    out.append("")
+    out.append("static const CANSignalDef DBC_SIGNALS[DBC_SIGNAL_COUNT] = {")
+    for sig in signals:
+        order = "ByteOrder::Intel" if sig.intel else "ByteOrder::Motorola"
+        mux = "CAN_MUX_NONE, 0" if sig.mux is None else "%d, %s" % (mux_byte[sig.msg_id], sig.mux[1:])
+        out.append("    { %s, %s, 0x%03X, { %d, %d, %s, %s, %s, %s }, { %s } },"
+                   % (c_string(sig.name), c_string(sig.unit), sig.msg_id, sig.start, sig.length, order,
+                      "true" if sig.signed else "false", c_float(sig.scale), c_float(sig.offset), mux))
+    out.append("};")
+    out.append("")
+    out.append("// Perfect hash over message IDs: slot = (id * DBC_HASH_MUL) >> DBC_HASH_SHIFT")
+    out.append("#define DBC_HASH_MUL 0x%08Xu" % mul)
+    out.append("#define DBC_HASH_SHIFT %d" % (32 - bits))
+    out.append("")
+    out.append("static const CANDispatchEntry DBC_DISPATCH[%d] = {" % len(table))
+    for i in table:
+        if i is None:
+            out.append("    { CAN_DISPATCH_EMPTY, 0, CAN_MUX_NONE },")
+        else:
+            mux = str(mux_byte[i]) if any(k >> 8 == i for k in mux_masks) else "CAN_MUX_NONE"
+            out.append("    { 0x%03X, 0x%XULL, %s }," % (i, masks[i], mux))
+    out.append("};")
+    out.append("")
+
+    if mux_masks:
+        keys = sorted(mux_masks)
+        mux_mul, mux_bits = perfect_hash(keys, 64)
+        mux_table = [None] * (1 << mux_bits)
+        for k in keys:
+            mux_table[((k * mux_mul) & 0xFFFFFFFFFFFFFFFF) >> (64 - mux_bits)] = k
+        out.append("// Multiplexed channels: slot = (((uint64_t)id << 8 | value) * DBC_MUX_HASH_MUL) >> DBC_MUX_HASH_SHIFT")
+        out.append("#define DBC_MUX_HASH_MUL 0x%016XULL" % mux_mul)
+        out.append("#define DBC_MUX_HASH_SHIFT %d" % (64 - mux_bits))
+        out.append("")
+        out.append("static const CANMuxDispatchEntry DBC_MUX_DISPATCH[%d] = {" % len(mux_table))
+        for k in mux_table:
+            if k is None:
+                out.append("    { CAN_DISPATCH_EMPTY, 0, 0 },")
+            else:
+                out.append("    { 0x%03X, %d, 0x%XULL }," % (k >> 8, k & 0xFF, mux_masks[k]))
+        out.append("};")
+        out.append("")
+
+    out.append("static inline uint64_t dbcChannels(uint32_t id, const uint8_t* data, uint8_t dlc) {")
+    out.append("    const CANDispatchEntry& e = DBC_DISPATCH[(uint32_t)(id * DBC_HASH_MUL) >> DBC_HASH_SHIFT];")
+    out.append("    if (e.id != id) return 0;")
+    if mux_masks:
+        out.append("    if (e.muxByte >= dlc) return e.channels;     // Not multiplexed, or too short to say")
+        out.append("    uint8_t value = data[e.muxByte];")
+        out.append("    const CANMuxDispatchEntry& m = DBC_MUX_DISPATCH[(uint32_t)((((uint64_t)id << 8 | value) * DBC_MUX_HASH_MUL) >> DBC_MUX_HASH_SHIFT)];")
+        out.append("    return m.id == id && m.value == value ? e.channels | m.channels : e.channels;")
+    else:
+        out.append("    return e.channels;")
+    out.append("}")
+    out.append("")
+
+    text = "\n".join(out)
+    old = None
+    if os.path.exists(out_path):
+        with open(out_path) as f:
+            old = f.read()
+    if old != text:                     # Don't touch the file (and trigger a rebuild) if nothing changed
+        os.makedirs(os.path.dirname(out_path) or ".", exist_ok=True)
+        with open(out_path, "w") as f:
+            f.write(text)
+    return len(signals), len(ids)
+
+
+def main(argv):
+    import argparse
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("dbc")
+    ap.add_argument("-o", "--output", default="include/dbc_signals.h")
+    args = ap.parse_args(argv)
+    n_sig, n_msg = generate(args.dbc, args.output)
+    print("%s: %d signals in %d messages" % (args.output, n_sig, n_msg))
+
+
+def platformio_hook(env):
+    dbc = env.GetProjectOption("custom_dbc_file", "")
+    if not dbc:
+        return
+    project = env.subst("$PROJECT_DIR")
+    out = os.path.join(env.subst("$PROJECT_INCLUDE_DIR"), "dbc_signals.h")
+    n_sig, n_msg = generate(os.path.join(project, dbc), out)
+    print("dbc_import: %s -> %d signals in %d messages" % (dbc, n_sig, n_msg))
+    # Global env, so lib/CAN Display is compiled with the same MAX_CHANNELS. At least 12 so
+    # screens.cpp's PARAM_COUNT channels exist. derivedSetup() leaves them alone with a
+    # table, 8 to 11 are DBC signals like the rest
+    env.Append(CPPDEFINES=["CAN_SIGNAL_TABLE", ("MAX_CHANNELS", max(12, n_sig))])
+
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
+else:
+    try:
+        Import("env")           # noqa: F821 (SCons)
+        platformio_hook(env)    # noqa: F821
+    except NameError:
+        pass
@@ -0,0 +1,189 @@
+"""
+Decode a DataLogger dump (the "datalog" partition) into CSV.
+
+    esptool.py read_flash 0x190000 0x270000 log.bin      # from the device, see partitions.csv
+    .pio/build/native/program trace.log --log log.bin    # or from a host replay
+    python tools/log_decode.py log.bin -o session.csv [--session N] [--names Knock,Boost,...]
+
+One row per sample that was logged, one column per channel (physical value, empty while the
+channel isn't fresh), so it loads straight into pandas (pd.read_csv(...).to_parquet(...)).
+Both block formats are handled: LOG_FORMAT_RAW and LOG_FORMAT_DELTA (lib/CAN Display/src/DataLogger.h).
+"""
+
+import csv
+import struct
+import sys
+
+BLOCK_SIZE = 4096
+MAGIC = 0x314C4343
+FORMAT_RAW = 1
+FORMAT_DELTA = 2
+
+TAG_TICK = 0x20
+TAG_KIND = 0xC0
+TAG_DELTA = 0x00
+TAG_KEYFRAME = 0x40
+TAG_FRESH = 0x80
+TAG_END = 0xFF
+
+HEADER = struct.Struct("<IIHBBHH")      # magic, sequence, session, format, channels, records, rateHz
+
+
+class Block:
+    def __init__(self, data):
+        (self.magic, self.sequence, self.session, self.format, self.channels,
+         self.records, self.rate_hz) = HEADER.unpack_from(data)
+        self.decimals = list(data[HEADER.size:HEADER.size + self.channels])
+        self.payload = (HEADER.size + self.channels + 3) & ~3     # sizeof(LogBlockHeader), 4 byte aligned
+        self.data = data
+
+
+def read_blocks(path):
+    blocks = []
+    with open(path, "rb") as f:
+        image = f.read()
+    for offset in range(0, len(image) - BLOCK_SIZE + 1, BLOCK_SIZE):
+        data = image[offset:offset + BLOCK_SIZE]
+        if struct.unpack_from("<I", data)[0] != MAGIC:
+            continue
+        blocks.append(Block(data))
+    if not blocks:
+        return []
+    # The ring wraps: oldest first, counting back from the newest sequence
+    newest = max(blocks, key=lambda b: b.sequence).sequence
+    blocks.sort(key=lambda b: (b.sequence - newest - 1) & 0xFFFFFFFF)
+    return blocks
+
+
+class Reader:
+    def __init__(self, data, pos):
+        self.data = data
+        self.pos = pos
+
+    def byte(self):
+        b = self.data[self.pos]
+        self.pos += 1
+        return b
+
+    def varint(self):
+        value, shift = 0, 0
+        while True:
+            b = self.byte()
+            value |= (b & 0x7F) << shift
+            shift += 7
+            if b < 0x80:
+                return value
+
+    def signed(self):
+        v = self.varint()
+        return (v >> 1) ^ -(v & 1)
+
+
+def raw_samples(block):
+    record = struct.Struct("<II%di" % block.channels)
+    for i in range(block.records):
+        fields = record.unpack_from(block.data, block.payload + i * record.size)
+        yield fields[0], fields[1], list(fields[2:])
+
+
+def delta_samples(block):
+    r = Reader(block.data, block.payload)
+    values = [0] * block.channels
+    fresh = 0
+    time_ms = None
+    pending = False                     # A sample is being assembled, emit it before the next tick
+    records = 0
+    try:
+        while records < block.records and r.pos < len(block.data):
+            tag = r.byte()
+            if tag == TAG_END:
+                break
+            records += 1
+            kind = tag & TAG_KIND
+            if kind == TAG_KEYFRAME:
+                if pending:
+                    yield time_ms, fresh, list(values)
+                time_ms = r.varint()
+                fresh = r.varint()
+                values = [r.signed() for _ in range(block.channels)]
+                pending = True
+                continue
+            if time_ms is None:
+                raise ValueError("block %d: delta before the first keyframe" % block.sequence)
+            if tag & TAG_TICK:
+                if pending:
+                    yield time_ms, fresh, list(values)
+                time_ms = (time_ms + r.varint()) & 0xFFFFFFFF
+                pending = True
+            if kind == TAG_DELTA:
+                values[tag & 0x1F] += r.signed()
+            elif kind == TAG_FRESH:
+                fresh = r.varint()
+            else:
+                raise ValueError("block %d: unknown tag 0x%02X" % (block.sequence, tag))
+    except IndexError:
+        sys.stderr.write("block %d: truncated\n" % block.sequence)
+    if pending:
+        yield time_ms, fresh, list(values)
+
+
+def samples(block):
+    if block.format == FORMAT_RAW:
+        return raw_samples(block)
+    if block.format == FORMAT_DELTA:
+        return delta_samples(block)
+    sys.stderr.write("block %d: unknown format %d, skipped\n" % (block.sequence, block.format))
+    return iter(())
+
+
+def physical(value, decimals):
+    if decimals == 0:
+        return str(value)
+    sign = "-" if value < 0 else ""
+    value = abs(value)
+    scale = 10 ** decimals
+    return "%s%d.%0*d" % (sign, value // scale, decimals, value % scale)
+
+
+def main(argv):
+    import argparse
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("dump")
+    ap.add_argument("-o", "--output", help="CSV file (default stdout)")
+    ap.add_argument("--session", type=int, help="only this session (default all)")
+    ap.add_argument("--names", help="comma separated column names for the channels")
+    args = ap.parse_args(argv)
+
+    blocks = read_blocks(args.dump)
+    if args.session is not None:
+        blocks = [b for b in blocks if b.session == args.session]
+    if not blocks:
+        sys.stderr.write("no log blocks found\n")
+        return 1
+
+    channels = max(b.channels for b in blocks)
+    names = args.names.split(",") if args.names else []
+    names += ["ch%d" % i for i in range(len(names), channels)]
+
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    writer = csv.writer(out)
+    writer.writerow(["session", "time_ms"] + names[:channels])
+    rows = 0
+    used = 0
+    for block in blocks:
+        used += BLOCK_SIZE
+        for time_ms, fresh, values in samples(block):
+            cells = [physical(v, block.decimals[i]) if fresh >> i & 1 else "" for i, v in enumerate(values)]
+            writer.writerow([block.session, time_ms] + cells + [""] * (channels - len(cells)))
+            rows += 1
+    if out is not sys.stdout:
+        out.close()
+
+    sessions = sorted(set(b.session for b in blocks))
+    sys.stderr.write("%d blocks (%d bytes), %d sessions (%s), %d rows\n"
+                     % (len(blocks), used, len(sessions), ", ".join(map(str, sessions)), rows))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))